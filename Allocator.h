@@ -0,0 +1,84 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Allocator_h
+#define __Base_Allocator_h
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+namespace Base
+{
+  // Memory source for the containers and String. Each container takes an
+  // optional Allocator* when it is constructed and uses it for its whole
+  // life; nullptr (the default) means plain malloc/realloc/free. Copies
+  // of a container get the default allocator unless one is given, while
+  // moves take the buffer and the allocator along with them.
+  class Allocator {
+    public:
+      virtual void* allocate(size_t size) = 0;
+      virtual void* reallocate(void* ptr, size_t oldSize, size_t size) = 0;
+      virtual void release(void* ptr, size_t size) = 0;
+      virtual ~Allocator(){}
+  };
+
+  // The helpers the containers call. They keep the default path free of
+  // virtual calls and throw std::bad_alloc instead of returning nullptr.
+  inline void* allocate(Allocator* alloc, size_t size)
+  {
+    void* ptr = alloc == nullptr ? malloc(size) : alloc->allocate(size);
+    if (ptr == nullptr)
+      throw std::bad_alloc();
+    return ptr;
+  }
+
+  // allocate, zero filled. The default path uses calloc, which takes
+  // large blocks already zeroed from the system, so their pages are only
+  // paid for as they are first touched.
+  inline void* allocateZeroed(Allocator* alloc, size_t size)
+  {
+    if (alloc == nullptr) {
+      void* ptr = calloc(1, size);
+      if (ptr == nullptr)
+        throw std::bad_alloc();
+      return ptr;
+    }
+    void* ptr = alloc->allocate(size);
+    if (ptr == nullptr)
+      throw std::bad_alloc();
+    memset(ptr, 0, size);
+    return ptr;
+  }
+
+  inline void* reallocate(Allocator* alloc, void* ptr, size_t oldSize, size_t size)
+  {
+    void* ret = alloc == nullptr ? realloc(ptr, size) : alloc->reallocate(ptr, oldSize, size);
+    if (ret == nullptr)
+      throw std::bad_alloc();
+    return ret;
+  }
+
+  inline void release(Allocator* alloc, void* ptr, size_t size)
+  {
+    if (alloc == nullptr)
+      free(ptr);
+    else if (ptr != nullptr)
+      alloc->release(ptr, size);
+  }
+}
+
+#endif
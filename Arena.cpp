@@ -0,0 +1,159 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/Arena.h"
+
+#include <string.h>
+
+using namespace Base;
+
+Arena::Arena(size_t chunkSize) :
+  chunkSize_(align(chunkSize)),
+  first_(nullptr),
+  current_(nullptr),
+  large_(nullptr),
+  cursor_(nullptr),
+  end_(nullptr),
+  last_(nullptr),
+  used_(0),
+  reserved_(0)
+{}
+
+Arena::~Arena()
+{
+  reset();
+  while (first_ != nullptr) {
+    Chunk* next = first_->next;
+    free(first_);
+    first_ = next;
+  }
+}
+
+char* Arena::data(Chunk* chunk)
+{
+  return (char*)chunk + align(sizeof(Chunk));
+}
+
+size_t Arena::align(size_t size)
+{
+  return (size + Align - 1) & ~(Align - 1);
+}
+
+void* Arena::allocate(size_t size)
+{
+  size = align(size == 0 ? 1 : size);
+  if (size > chunkSize_ / 2)
+    return allocateLarge(size);
+  if (size > (size_t)(end_ - cursor_))
+    nextChunk();
+  last_ = cursor_;
+  cursor_ += size;
+  used_ += size;
+  return last_;
+}
+
+void* Arena::reallocate(void* ptr, size_t oldSize, size_t size)
+{
+  if (ptr == nullptr)
+    return allocate(size);
+  if (ptr == last_ && align(size) <= (size_t)(end_ - last_)) {
+    used_ += align(size) - (cursor_ - last_);
+    cursor_ = last_ + align(size);
+    return ptr;
+  }
+  if (large_ != nullptr && ptr == data(large_) && size > chunkSize_ / 2) {
+    // The newest large block is a malloc of its own, so let realloc move
+    // (or remap) it rather than copying into yet another block
+    size = align(size);
+    Chunk* chunk = (Chunk*)realloc(large_, align(sizeof(Chunk)) + size);
+    if (chunk == nullptr)
+      return nullptr;
+    reserved_ += size - chunk->size;
+    used_ += size - chunk->size;
+    chunk->size = size;
+    large_ = chunk;
+    return data(chunk);
+  }
+  if (size <= oldSize)
+    return ptr;
+  void* ret = allocate(size);
+  memcpy(ret, ptr, oldSize);
+  return ret;
+}
+
+void Arena::release(void*, size_t)
+{
+  // Reclaimed by reset
+}
+
+void Arena::reset()
+{
+  while (large_ != nullptr) {
+    Chunk* next = large_->next;
+    reserved_ -= large_->size;
+    free(large_);
+    large_ = next;
+  }
+  current_ = nullptr;
+  cursor_ = nullptr;
+  end_ = nullptr;
+  last_ = nullptr;
+  used_ = 0;
+}
+
+size_t Arena::used() const
+{
+  return used_;
+}
+
+size_t Arena::reserved() const
+{
+  return reserved_;
+}
+
+void* Arena::allocateLarge(size_t size)
+{
+  Chunk* chunk = (Chunk*)malloc(align(sizeof(Chunk)) + size);
+  if (chunk == nullptr)
+    throw std::bad_alloc();
+  chunk->next = large_;
+  chunk->size = size;
+  large_ = chunk;
+  reserved_ += size;
+  used_ += size;
+  return data(chunk);
+}
+
+void Arena::nextChunk()
+{
+  Chunk* next = current_ == nullptr ? first_ : current_->next;
+  if (next == nullptr) {
+    next = (Chunk*)malloc(align(sizeof(Chunk)) + chunkSize_);
+    if (next == nullptr)
+      throw std::bad_alloc();
+    next->next = nullptr;
+    next->size = chunkSize_;
+    if (current_ == nullptr)
+      first_ = next;
+    else
+      current_->next = next;
+    reserved_ += chunkSize_;
+  }
+  current_ = next;
+  cursor_ = data(next);
+  end_ = cursor_ + next->size;
+  last_ = nullptr;
+}
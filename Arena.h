@@ -0,0 +1,78 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Arena_h
+#define __Base_Arena_h
+
+#include "Base/Allocator.h"
+#include "Base/compat/sizes.h"
+#include <stddef.h>
+
+namespace Base
+{
+  // Chunked bump allocator. Allocations are carved off the current chunk
+  // and are never returned individually; reset() hands every chunk back
+  // for reuse at once, so a request's containers can be dropped in O(1).
+  // reallocate grows the most recent allocation in place when it still
+  // fits, which is the common case for a List or String being filled.
+  // Requests larger than half a chunk get a block of their own, which
+  // reset frees; the newest such block is resized with realloc. Objects
+  // using the arena must not be touched (including their destructors)
+  // after reset. Not thread safe.
+  class Arena : public Allocator {
+    public:
+      Arena(size_t chunkSize = SZ_64K);
+      Arena(Arena const&) = delete;
+      Arena& operator= (Arena const&) = delete;
+      ~Arena();
+
+      void* allocate(size_t size) override;
+      void* reallocate(void* ptr, size_t oldSize, size_t size) override;
+      void release(void* ptr, size_t size) override;
+
+      void reset();
+
+      // Bytes handed out since the last reset, after alignment
+      size_t used() const;
+      // Bytes held from the system, including reusable chunks
+      size_t reserved() const;
+
+    private:
+      struct Chunk {
+        Chunk* next;
+        size_t size;
+      };
+
+      static constexpr size_t Align = alignof(max_align_t);
+
+      size_t chunkSize_;
+      Chunk* first_;
+      Chunk* current_;
+      Chunk* large_;
+      char* cursor_;
+      char* end_;
+      char* last_;
+      size_t used_;
+      size_t reserved_;
+
+      static char* data(Chunk* chunk);
+      static size_t align(size_t size);
+      void* allocateLarge(size_t size);
+      void nextChunk();
+  };
+}
+
+#endif
@@ -0,0 +1,133 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/Atom.h"
+
+#include <stdlib.h>
+#include <mutex>
+#include <new>
+
+using namespace Base;
+
+// Open addressing set of entries split into independently locked shards.
+// The top bits of the hash pick the shard and the low bits the slot.
+class Atom::Pool {
+  public:
+    static Pool& instance()
+    {
+      static Pool pool;
+      return pool;
+    }
+
+    Entry const* intern(StringView value, bool add)
+    {
+      uint64_t hash = value.hash();
+      Shard& shard = shards_[hash >> (64 - ShardBits)];
+      std::lock_guard<std::mutex> guard(shard.lock);
+      size_t mask = shard.capacity - 1;
+      for (size_t i = hash & mask; shard.slots != nullptr; i = (i + 1) & mask) {
+        Entry const* entry = shard.slots[i];
+        if (entry == nullptr)
+          break;
+        if (entry->hash == hash && entry->value == value)
+          return entry;
+      }
+      if (!add)
+        return nullptr;
+      if ((shard.count + 1) * 4 > shard.capacity * 3)
+        grow(shard);
+      Entry* entry = new Entry{hash, String(value)};
+      entry->value.share();
+      insert(shard, entry);
+      return entry;
+    }
+
+    size_t count()
+    {
+      size_t ret = 0;
+      for (size_t i = 0; i < ShardCount; i++) {
+        std::lock_guard<std::mutex> guard(shards_[i].lock);
+        ret += shards_[i].count;
+      }
+      return ret;
+    }
+
+  private:
+    static constexpr size_t ShardBits = 6;
+    static constexpr size_t ShardCount = 1 << ShardBits;
+
+    struct Shard {
+      std::mutex lock;
+      Entry const** slots = nullptr;
+      size_t capacity = 0;
+      size_t count = 0;
+    };
+
+    Shard shards_[ShardCount];
+
+    static void insert(Shard& shard, Entry const* entry)
+    {
+      size_t mask = shard.capacity - 1;
+      size_t i = entry->hash & mask;
+      while (shard.slots[i] != nullptr)
+        i = (i + 1) & mask;
+      shard.slots[i] = entry;
+      shard.count += 1;
+    }
+
+    static void grow(Shard& shard)
+    {
+      Entry const** old = shard.slots;
+      size_t oldCapacity = shard.capacity;
+      size_t capacity = oldCapacity == 0 ? 16 : oldCapacity * 2;
+      Entry const** slots = (Entry const**)calloc(capacity, sizeof(Entry const*));
+      if (slots == nullptr)
+        throw std::bad_alloc();
+      shard.slots = slots;
+      shard.capacity = capacity;
+      shard.count = 0;
+      for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i] != nullptr)
+          insert(shard, old[i]);
+      }
+      free(old);
+    }
+};
+
+Atom::Atom() :
+  entry_(nullptr)
+{
+  static Entry const* empty = Pool::instance().intern(StringView(), true);
+  entry_ = empty;
+}
+
+Atom::Atom(StringView value) :
+  entry_(Pool::instance().intern(value, true))
+{}
+
+bool Atom::find(StringView value, Atom& atom)
+{
+  Entry const* entry = Pool::instance().intern(value, false);
+  if (entry == nullptr)
+    return false;
+  atom.entry_ = entry;
+  return true;
+}
+
+size_t Atom::count()
+{
+  return Pool::instance().count();
+}
@@ -0,0 +1,77 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Atom_h
+#define __Base_Atom_h
+
+#include "Base/Hash.h"
+#include "Base/String.h"
+#include "Base/StringView.h"
+
+namespace Base
+{
+  // Interned string. Every Atom made from the same chars refers to the same
+  // pool entry, so equality is a pointer compare and the hash is computed
+  // once, when the chars are first interned. Entries live for the rest of
+  // the process; intern names, tags and other small vocabularies, not
+  // arbitrary data. The pool is safe to use from any thread. Hash::setSeed
+  // must be called before the first Atom is made, if at all.
+  class Atom {
+    public:
+      // The empty string
+      Atom();
+      explicit Atom(StringView value);
+      explicit Atom(char const* value) : Atom(StringView(value)) {}
+      explicit Atom(String const& value) : Atom(value.view()) {}
+
+      // Looks up an existing atom without adding to the pool
+      static bool find(StringView value, Atom& atom);
+      // Number of distinct atoms interned so far
+      static size_t count();
+
+      StringView view() const { return entry_->value.view(); }
+      operator StringView() const { return view(); }
+      char const* c_str() const { return entry_->value.c_str(); }
+      size_t length() const { return entry_->value.length(); }
+      // Cheap: the pool's String is shared, so this does not copy the chars
+      String toString() const { return entry_->value; }
+
+      uint64_t hash() const { return entry_->hash; }
+
+      bool operator==(Atom const& other) const { return entry_ == other.entry_; }
+      bool operator!=(Atom const& other) const { return entry_ != other.entry_; }
+
+    private:
+      struct Entry {
+        uint64_t hash;
+        String value;
+      };
+
+      class Pool;
+
+      Entry const* entry_;
+  };
+
+  template<>
+  struct Hasher<Atom> {
+    static uint64_t hash(Atom const& value)
+    {
+      return value.hash();
+    }
+  };
+}
+
+#endif
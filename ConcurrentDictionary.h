@@ -0,0 +1,315 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_ConcurrentDictionary_h
+#define __Base_ConcurrentDictionary_h
+
+#include "Base/FlatDictionary.h"
+#include "Base/Hash.h"
+#include "Base/List.h"
+#include "Base/compat/sizes.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace Base {
+  template <typename T_Key, typename T_Value>
+  class ConcurrentDictionaryIter;
+
+  // Dictionary that may be used from any number of threads at once. Keys
+  // are split across shards by the top bits of their hash, and each shard
+  // is a FlatDictionary behind its own reader/writer lock, so threads only
+  // contend when they touch the same shard, and readers of a shard never
+  // block each other. Values are copied out rather than returned by
+  // reference, since a reference would outlive the lock protecting it.
+  template <typename T_Key, typename T_Value>
+  class ConcurrentDictionary {
+  public:
+    // Copy of one entry, as produced by the iterator
+    class KVP {
+      public:
+        T_Key key;
+        T_Value value;
+    };
+
+    // shards is rounded up to a power of two
+    ConcurrentDictionary(size_t size = 4, size_t shards = 64) :
+      shardBits_(0),
+      shards_(nullptr)
+    {
+      while (((size_t)1 << shardBits_) < shards)
+        shardBits_++;
+      // new[] only guarantees max_align_t before C++17
+      void* mem = nullptr;
+      if (posix_memalign(&mem, SZ_CACHE_LINE, sizeof(Shard) * shardCount()) != 0)
+        throw std::bad_alloc();
+      shards_ = (Shard*)mem;
+      for (off_t i = 0; i < (ssize_t)shardCount(); i++)
+        new (&shards_[i])Shard(size / shardCount() + 1);
+    }
+
+    ConcurrentDictionary(ConcurrentDictionary<T_Key, T_Value> const&) = delete;
+    ConcurrentDictionary<T_Key, T_Value>& operator= (ConcurrentDictionary<T_Key, T_Value> const&) = delete;
+
+    // Returns false (and leaves the entry alone) when the key is present
+    bool add(T_Key const& key, T_Value const& value)
+    {
+      Shard& shard = shardFor(key);
+      WriteGuard guard(shard.lock);
+      if (shard.dict.containsKey(key))
+        return false;
+      shard.dict.add(key, value);
+      return true;
+    }
+
+    bool add(T_Key&& key, T_Value&& value)
+    {
+      Shard& shard = shardFor(key);
+      WriteGuard guard(shard.lock);
+      if (shard.dict.containsKey(key))
+        return false;
+      shard.dict.add(std::move(key), std::move(value));
+      return true;
+    }
+
+    // Returns false when the key was not present
+    bool remove(T_Key const& key)
+    {
+      Shard& shard = shardFor(key);
+      WriteGuard guard(shard.lock);
+      return shard.dict.remove(key);
+    }
+
+    bool containsKey(T_Key const& key) const
+    {
+      Shard& shard = shardFor(key);
+      ReadGuard guard(shard.lock);
+      return shard.dict.containsKey(key);
+    }
+
+    // Copies the value into value and returns true when the key is present
+    bool tryGet(T_Key const& key, T_Value& value) const
+    {
+      Shard& shard = shardFor(key);
+      ReadGuard guard(shard.lock);
+      T_Value* found = shard.dict.tryGet(key);
+      if (found == nullptr)
+        return false;
+      value = *found;
+      return true;
+    }
+
+    // Returns the value for key, adding value first if the key is absent
+    T_Value getOrAdd(T_Key const& key, T_Value const& value)
+    {
+      Shard& shard = shardFor(key);
+      {
+        ReadGuard guard(shard.lock);
+        T_Value* found = shard.dict.tryGet(key);
+        if (found != nullptr)
+          return *found;
+      }
+      // Another writer may have added it since; getOrAdd searches once
+      WriteGuard guard(shard.lock);
+      return shard.dict.getOrAdd(key, [&value]() -> T_Value const& { return value; });
+    }
+
+    // Sum of the shard counts; only exact while no writer is active
+    size_t count() const
+    {
+      size_t ret = 0;
+      for (off_t i = 0; i < (ssize_t)shardCount(); i++) {
+        ReadGuard guard(shards_[i].lock);
+        ret += shards_[i].dict.count();
+      }
+      return ret;
+    }
+
+    ConcurrentDictionaryIter<T_Key, T_Value> iter() const {
+      return ConcurrentDictionaryIter<T_Key, T_Value>(*this);
+    }
+
+    ~ConcurrentDictionary()
+    {
+      for (off_t i = 0; i < (ssize_t)shardCount(); i++)
+        shards_[i].~Shard();
+      free(shards_);
+    }
+
+  private:
+    // Writer-preferring reader/writer spin lock. The top bit marks a
+    // writer (holding or waiting); the rest count readers. A writer claims
+    // the bit first, which stops new readers, then waits for the current
+    // ones to leave. Waiters yield so oversubscribed threads still progress.
+    class Lock {
+      public:
+        Lock() : state_(0) {}
+
+        void lockShared()
+        {
+          uint32_t state = state_.load(std::memory_order_relaxed);
+          for (unsigned spins = 0;; spins++) {
+            if ((state & Writer) == 0 &&
+                state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire))
+              return;
+            backoff(spins);
+            state = state_.load(std::memory_order_relaxed);
+          }
+        }
+
+        void unlockShared()
+        {
+          state_.fetch_sub(1, std::memory_order_release);
+        }
+
+        void lock()
+        {
+          uint32_t state = state_.load(std::memory_order_relaxed);
+          for (unsigned spins = 0;; spins++) {
+            if ((state & Writer) == 0 &&
+                state_.compare_exchange_weak(state, state | Writer, std::memory_order_acquire))
+              break;
+            backoff(spins);
+            state = state_.load(std::memory_order_relaxed);
+          }
+          for (unsigned spins = 0; state_.load(std::memory_order_acquire) != Writer; spins++)
+            backoff(spins);
+        }
+
+        void unlock()
+        {
+          state_.fetch_and(~Writer, std::memory_order_release);
+        }
+
+      private:
+        static constexpr uint32_t Writer = 0x80000000u;
+        std::atomic<uint32_t> state_;
+
+        static void backoff(unsigned spins)
+        {
+          if (spins >= 16)
+            std::this_thread::yield();
+        }
+    };
+
+    class ReadGuard {
+      public:
+        ReadGuard(Lock& lock) : lock_(lock) { lock_.lockShared(); }
+        ~ReadGuard() { lock_.unlockShared(); }
+      private:
+        Lock& lock_;
+    };
+
+    class WriteGuard {
+      public:
+        WriteGuard(Lock& lock) : lock_(lock) { lock_.lock(); }
+        ~WriteGuard() { lock_.unlock(); }
+      private:
+        Lock& lock_;
+    };
+
+    struct alignas(SZ_CACHE_LINE) Shard {
+      mutable Lock lock;
+      FlatDictionary<T_Key, T_Value> dict;
+
+      Shard(size_t size) : dict(size) {}
+    };
+
+    size_t shardBits_;
+    Shard* shards_;
+
+    friend class ConcurrentDictionaryIter<T_Key, T_Value>;
+
+    size_t shardCount() const
+    {
+      return (size_t)1 << shardBits_;
+    }
+
+    Shard& shardFor(T_Key const& key) const
+    {
+      if (shardBits_ == 0)
+        return shards_[0];
+      return shards_[hash<T_Key>(key) >> (64 - shardBits_)];
+    }
+  };
+
+  // Walks the dictionary one shard at a time, copying each shard's entries
+  // under its read lock before handing them out. Every entry that is
+  // present for the whole walk is seen exactly once; entries added or
+  // removed meanwhile may or may not be. The dictionary may be freely
+  // modified while an iterator is in use.
+  template <typename T_Key, typename T_Value>
+  class ConcurrentDictionaryIter {
+    public:
+      ConcurrentDictionaryIter(ConcurrentDictionary<T_Key, T_Value> const& dict) :
+        shard_(0),
+        i_(0),
+        dict_(&dict)
+      {
+        load();
+      }
+
+      void next()
+      {
+        if (!valid())
+          return;
+        i_++;
+        if (i_ >= (ssize_t)items_.count()) {
+          shard_++;
+          load();
+        }
+      }
+
+      bool valid() const {
+        return i_ < (ssize_t)items_.count();
+      }
+
+      typename ConcurrentDictionary<T_Key, T_Value>::KVP const& value() const
+      {
+        assert(valid());
+        return items_[i_];
+      }
+
+    private:
+      typedef typename ConcurrentDictionary<T_Key, T_Value>::KVP KVP;
+      typedef typename ConcurrentDictionary<T_Key, T_Value>::ReadGuard ReadGuard;
+
+      size_t shard_;
+      off_t i_;
+      List<KVP> items_;
+      ConcurrentDictionary<T_Key, T_Value> const* dict_;
+
+      // Copies the next non-empty shard, starting at shard_
+      void load()
+      {
+        items_ = List<KVP>();
+        i_ = 0;
+        for (; shard_ < dict_->shardCount(); shard_++) {
+          auto& shard = dict_->shards_[shard_];
+          ReadGuard guard(shard.lock);
+          for (auto it = shard.dict.iter(); it.valid(); it.next())
+            items_.add(KVP{it.value().key, it.value().value});
+          if (items_.count() > 0)
+            return;
+        }
+      }
+  };
+}
+
+#endif
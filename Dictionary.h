@@ -19,7 +19,11 @@
 
 #include "Base/Hash.h"
 #include "Base/List.h"
+#include "Base/SlabPool.h"
+#include "Base/Stats.h"
 #include <assert.h>
+#include <type_traits>
+#include <utility>
 
 namespace Base {
   template <typename T_Key, typename T_Value>
@@ -39,102 +43,147 @@ namespace Base {
       {}
   };
 
-    Dictionary(size_t size = 4) :
+    Dictionary(size_t size = 4, Allocator* alloc = nullptr) :
       count_(0),
       tableSize_(size),
-      table_(nullptr)
+      table_(nullptr),
+      oldTable_(nullptr),
+      oldTableSize_(0),
+      migrated_(0),
+      maxLoadFactor_(1.0f),
+      incremental_(false),
+      alloc_(alloc),
+      nodes_(sizeof(Node), alignof(Node), alloc)
     {
       assert(tableSize_ > 0);
-      table_ = new Node*[tableSize_];
-      for (off_t i = 0; i < (ssize_t)tableSize_; ++i)
-        table_[i] = nullptr;
+      table_ = newTable(tableSize_);
     }
 
-    Dictionary(Dictionary<T_Key, T_Value> const& dict) :
+    Dictionary(Dictionary<T_Key, T_Value> const& dict, Allocator* alloc = nullptr) :
       count_(0),
-      tableSize_(dict.count() < 4 ? 4 : dict.count()),
-      table_(nullptr)
+      tableSize_(0),
+      table_(nullptr),
+      oldTable_(nullptr),
+      oldTableSize_(0),
+      migrated_(0),
+      maxLoadFactor_(dict.maxLoadFactor_),
+      incremental_(dict.incremental_),
+      alloc_(alloc),
+      nodes_(sizeof(Node), alignof(Node), alloc)
     {
-      
-      assert(tableSize_ > 0);
-      table_ = new Node*[tableSize_];
-      for (off_t i = 0; i < (ssize_t)tableSize_; ++i)
-        table_[i] = nullptr;
+      tableSize_ = sizeFor(dict.count());
+      table_ = newTable(tableSize_);
 
       for (auto it = dict.iter(); it.valid(); it.next()) {
         add(it.value().key, it.value().value);
       }
     }
     
+    Dictionary(Dictionary<T_Key, T_Value>&& dict) noexcept :
+      count_(dict.count_),
+      tableSize_(dict.tableSize_),
+      table_(dict.table_),
+      oldTable_(dict.oldTable_),
+      oldTableSize_(dict.oldTableSize_),
+      migrated_(dict.migrated_),
+      maxLoadFactor_(dict.maxLoadFactor_),
+      incremental_(dict.incremental_),
+      alloc_(dict.alloc_),
+      nodes_(std::move(dict.nodes_))
+    {
+      dict.count_ = 0;
+      dict.tableSize_ = 0;
+      dict.table_ = nullptr;
+      dict.oldTable_ = nullptr;
+      dict.oldTableSize_ = 0;
+      dict.migrated_ = 0;
+    }
+
     Dictionary<T_Key, T_Value>& operator= (Dictionary<T_Key, T_Value> const& dict)
     {
+      if (&dict == this)
+        return *this;
+      Allocator* alloc = alloc_;
       this->~Dictionary<T_Key, T_Value>();
-      new(this)Dictionary<T_Key, T_Value>(dict);
+      new(this)Dictionary<T_Key, T_Value>(dict, alloc);
+      return *this;
+    }
+
+    Dictionary<T_Key, T_Value>& operator= (Dictionary<T_Key, T_Value>&& dict) noexcept
+    {
+      if (&dict == this)
+        return *this;
+      this->~Dictionary<T_Key, T_Value>();
+      new(this)Dictionary<T_Key, T_Value>(std::move(dict));
       return *this;
     }
 
     void add(T_Key const& key, T_Value const& value)
     {
-      assert(!containsKey(key));
+      emplace(key, value);
+    }
 
-      if (count_ == tableSize_)
-        minSize(count_ * 2);
+    void add(T_Key&& key, T_Value&& value)
+    {
+      emplace(std::move(key), std::move(value));
+    }
 
-      int hashValue = hash<T_Key>(key);
-      off_t index = static_cast<off_t>(hashValue) % tableSize_;
-      Node* node = table_[index];
-      while(node != nullptr)
-      {
-        assert(node->key != key);
-        node = node->next;
-      }
-      node = new Node{
-        table_[index],
-        key, 
-        value
-      };
-      table_[index] = node;
-      count_ += 1;
+    template <typename K, typename... Args>
+    T_Value& emplace(K&& key, Args&&... args)
+    {
+      Node* node = makeNode(std::forward<K>(key), std::forward<Args>(args)...);
+      assert(!containsKey(node->key));
+      return insert(node, hash<T_Key>(node->key));
     }
 
-    void remove(T_Key const& key)
+    // The value for key, adding factory()'s result first if key is absent.
+    // The key is hashed and searched for once; a T_Key is only built from
+    // it when an entry is added.
+    template <typename K, typename F>
+    T_Value& getOrAdd(K&& key, F&& factory)
     {
-      int hashValue = hash<T_Key>(key);
-      off_t index = static_cast<off_t>(hashValue) % tableSize_;
-      Node* node = table_[index];
-      Node* prev = nullptr;
-      while(node != nullptr) {
-        if(node->key == key) {
-          if (prev == nullptr) {
-            table_[index] = node->next;
-            delete node;
-            count_ -= 1;
-            return;
-          } else {
-            prev->next = node->next;
-            delete node;
-            count_ -= 1;
-            return;
-          }
-        }
-        prev = node;
-        node = node->next;
-      }
-      //should not reach here (removes return)
-      assert(false);
+      Probe<K> const& probe = key;
+      uint64_t hashValue = hash<Probe<K>>(probe);
+      Node** link = findLink(probe, hashValue);
+      if (link != nullptr)
+        return (*link)->value;
+      return insert(makeNode(std::forward<K>(key), factory()), hashValue);
     }
 
-    bool containsKey(T_Key const& key) const
+    // Assigns value to key's entry, adding the entry if key is absent
+    template <typename K, typename V>
+    T_Value& addOrUpdate(K&& key, V&& value)
     {
-      int hashValue = hash<T_Key>(key);
-      off_t index = static_cast<off_t>(hashValue) % tableSize_;
-      Node* node = table_[index];
-      while(node != nullptr) {
-        if(node->key == key)
-          return true;
-        node = node->next;
-      }
-      return false;
+      Probe<K> const& probe = key;
+      uint64_t hashValue = hash<Probe<K>>(probe);
+      Node** link = findLink(probe, hashValue);
+      if (link != nullptr)
+        return (*link)->value = std::forward<V>(value);
+      return insert(makeNode(std::forward<K>(key), std::forward<V>(value)), hashValue);
+    }
+
+    // Removes key's entry, if any; true when there was one
+    template <typename K>
+    bool remove(K const& key)
+    {
+      if (oldTable_ != nullptr)
+        migrate(MigrateStep);
+      Node** link = findLink<Probe<K>>(key);
+      if (link == nullptr)
+        return false;
+      Node* node = *link;
+      *link = node->next;
+      deleteNode(node);
+      count_ -= 1;
+      return true;
+    }
+
+    template <typename K>
+    bool containsKey(K const& key) const
+    {
+      if (tableSize_ == 0)
+        return false;
+      return findLink<Probe<K>>(key) != nullptr;
     }
 
     size_t count() const {
@@ -143,52 +192,120 @@ namespace Base {
 
     Base::List<T_Key> keys() const {
       Base::List<T_Key> keys_ret(count());
-      for (off_t i = 0; i < (ssize_t)tableSize_; i++) {
-        if (table_[i] != nullptr) {
-          Node* node = table_[i];
-          while (node != nullptr) {
-                  keys_ret.add(node->key);
-                  node = node->next;
-          }
-        }
-      }
+      for (auto it = iter(); it.valid(); it.next())
+        keys_ret.add(it.value().key);
       return keys_ret;
     }
 
-    T_Value& operator[] (T_Key const& key) const
+    template <typename K>
+    T_Value& operator[] (K const& key) const
     {
-      int hashValue = hash<T_Key>(key);
-      off_t index = static_cast<off_t>(hashValue) % tableSize_;
-      Node* node = table_[index];
-      while(node != nullptr) {
-        if(node->key == key)
-          break;
-        node = node->next;
-      }
-      assert(node != nullptr);
-      return node->value;
+      assert(tableSize_ > 0);
+      Node** link = findLink<Probe<K>>(key);
+      assert(link != nullptr);
+      return (*link)->value;
+    }
+
+    // Key's value, or nullptr when it is absent; saves the second search
+    // of a containsKey then operator[]
+    template <typename K>
+    T_Value* tryGet(K const& key) const
+    {
+      Node** link = findLink<Probe<K>>(key);
+      return link != nullptr ? &(*link)->value : nullptr;
+    }
+
+    // Sizes the table so that count entries fit without it growing again.
+    // Also finishes an incremental rehash, so a table that is done being
+    // written can be left with a single table to search.
+    void reserve(size_t count)
+    {
+      size_t size = sizeFor(count);
+      if (size > tableSize_)
+        this->size(size);
+      else
+        finishRehash();
+    }
+
+    // Sizes the table to just fit the current entries at the max load
+    // factor. Nodes of removed entries are kept for reuse regardless.
+    void shrinkToFit()
+    {
+      size_t size = sizeFor(count_);
+      if (size != tableSize_)
+        this->size(size);
+      else
+        finishRehash();
+    }
+
+    // Entries per bucket at which the table doubles, 1 by default. Lower
+    // means shorter chains for more memory; takes effect on the next add.
+    void setMaxLoadFactor(float maxLoadFactor)
+    {
+      assert(maxLoadFactor > 0);
+      maxLoadFactor_ = maxLoadFactor;
+    }
+
+    float maxLoadFactor() const {
+      return maxLoadFactor_;
+    }
+
+    float loadFactor() const {
+      return tableSize_ == 0 ? 0 : (float)count_ / tableSize_;
+    }
+
+    size_t bucketCount() const {
+      return tableSize_;
+    }
+
+    // When on, growing allocates the new table and then moves a few old
+    // buckets over on each add and remove, instead of rehashing every
+    // entry in the add that hit the limit. Lookups check both tables while
+    // a move is under way, and being const they do not advance it; call
+    // reserve or shrinkToFit once writing is done to finish it. Turning it
+    // off finishes any move at once.
+    void setIncrementalRehash(bool incremental)
+    {
+      incremental_ = incremental;
+      if (!incremental_)
+        finishRehash();
+    }
+
+    bool incrementalRehash() const {
+      return incremental_;
+    }
+
+    // True while entries are still being moved to a grown table
+    bool rehashing() const {
+      return oldTable_ != nullptr;
     }
 
     DictionaryIter<T_Key, T_Value> iter() const {
       return DictionaryIter<T_Key, T_Value>(*this);
     }
 
+    Allocator* allocator() const {
+      return alloc_;
+    }
+
     ~Dictionary()
     {
-      for (off_t i = 0; i < (ssize_t)tableSize_; ++i)
-      {
-        Node* node = table_[i];
-        while(node != nullptr)
-        {
-          Node* next = node->next;
-          delete node;
-          node = next;
-        }
+      // The node pool frees whole slabs, so nodes only need visiting when
+      // there are destructors to run
+      if (!std::is_trivially_destructible<Node>::value) {
+        destroyNodes(table_, 0, tableSize_);
+        destroyNodes(oldTable_, migrated_, oldTableSize_);
       }
-      delete[] table_;
+      release(alloc_, table_, sizeof(Node*) * tableSize_);
+      release(alloc_, oldTable_, sizeof(Node*) * oldTableSize_);
     }
 
   private:
+    // Old buckets moved per add or remove during an incremental rehash.
+    // The move finishes within tableSize / MigrateStep operations, well
+    // before the table can fill up again at any sane max load factor.
+    static constexpr size_t MigrateStep = 16;
+
     struct Node {
       Node* next;
       T_Key key;
@@ -198,40 +315,221 @@ namespace Base {
     size_t count_;
     size_t tableSize_;
     Node** table_;
+    // During an incremental rehash, the previous table; its buckets below
+    // migrated_ have already been moved to table_
+    Node** oldTable_;
+    size_t oldTableSize_;
+    size_t migrated_;
+    float maxLoadFactor_;
+    bool incremental_;
+    Allocator* alloc_;
+    // Nodes come from slabs and removed ones are reused, rather than each
+    // being a malloc of its own
+    SlabPool nodes_;
 
     friend class DictionaryIter<T_Key, T_Value>;
 
+    // Keys other than T_Key are searched for as T_Key's LookupKey, so
+    // e.g. a char const* probes a String table as a StringView
+    template <typename K>
+    using Probe = typename std::conditional<
+      std::is_same<typename std::decay<K>::type, T_Key>::value,
+      T_Key, typename LookupKey<T_Key>::type>::type;
+
+    size_t maxCount(size_t size) const
+    {
+      return (size_t)(size * (double)maxLoadFactor_);
+    }
+
+    // Smallest table (of at least 4 buckets) that holds count entries
+    size_t sizeFor(size_t count) const
+    {
+      size_t size = std::max<size_t>((size_t)(count / (double)maxLoadFactor_), 4);
+      while (maxCount(size) < count)
+        size++;
+      return size;
+    }
+
+    // The link (bucket or next pointer) that points at key's node, or
+    // nullptr when it is absent
+    template <typename K>
+    Node** findLink(K const& key) const
+    {
+      return findLink(key, hash<K>(key));
+    }
+
+    template <typename K>
+    Node** findLink(K const& key, uint64_t hashValue) const
+    {
+      // A moved-from table has no buckets until its next add
+      if (tableSize_ == 0)
+        return nullptr;
+      size_t probes = 0;
+      if (oldTable_ != nullptr) {
+        size_t index = hashValue % oldTableSize_;
+        if (index >= migrated_) {
+          for (Node** link = &oldTable_[index]; *link != nullptr; link = &(*link)->next) {
+            probes++;
+            if ((*link)->key == key) {
+              Stats::of<Dictionary<T_Key, T_Value>>().probed(probes);
+              return link;
+            }
+          }
+        }
+      }
+      for (Node** link = &table_[hashValue % tableSize_]; *link != nullptr; link = &(*link)->next) {
+        probes++;
+        if ((*link)->key == key) {
+          Stats::of<Dictionary<T_Key, T_Value>>().probed(probes);
+          return link;
+        }
+      }
+      Stats::of<Dictionary<T_Key, T_Value>>().probed(probes);
+      return nullptr;
+    }
+
+    template <typename K, typename... Args>
+    Node* makeNode(K&& key, Args&&... args)
+    {
+      void* mem = newNode();
+      try {
+        return new (mem)Node{
+          nullptr,
+          T_Key(std::forward<K>(key)),
+          T_Value(std::forward<Args>(args)...)
+        };
+      } catch (...) {
+        nodes_.release(mem);
+        throw;
+      }
+    }
+
+    // Links in node, whose key is absent and hashes to hashValue
+    T_Value& insert(Node* node, uint64_t hashValue)
+    {
+      if (oldTable_ != nullptr)
+        migrate(MigrateStep);
+      if (count_ >= maxCount(tableSize_))
+        grow();
+
+      off_t index = hashValue % tableSize_;
+      node->next = table_[index];
+      table_[index] = node;
+      count_ += 1;
+      Stats::of<Dictionary<T_Key, T_Value>>().loaded(count_, tableSize_);
+      return node->value;
+    }
+
+    void grow()
+    {
+      size_t size = std::max<size_t>(tableSize_ * 2, 4);
+      while (maxCount(size) <= count_)
+        size *= 2;
+      if (!incremental_) {
+        this->size(size);
+        return;
+      }
+      finishRehash();
+      Stats::of<Dictionary<T_Key, T_Value>>().resized();
+      oldTable_ = table_;
+      oldTableSize_ = tableSize_;
+      migrated_ = 0;
+      table_ = newTable(size);
+      tableSize_ = size;
+    }
+
+    // Moves up to buckets old buckets into table_
+    void migrate(size_t buckets)
+    {
+      size_t end = std::min(migrated_ + buckets, oldTableSize_);
+      for (; migrated_ < end; migrated_++) {
+        Node* node = oldTable_[migrated_];
+        while (node != nullptr) {
+          Node* next = node->next;
+          off_t index = hash<T_Key>(node->key) % tableSize_;
+          node->next = table_[index];
+          table_[index] = node;
+          node = next;
+        }
+      }
+      // Start loading the nodes the next step moves, so it finds them in
+      // cache instead of missing once per node in turn
+      size_t next = std::min(migrated_ + MigrateStep, oldTableSize_);
+      for (size_t i = migrated_; i < next; i++) {
+        if (oldTable_[i] != nullptr)
+          __builtin_prefetch(oldTable_[i]);
+      }
+      if (migrated_ == oldTableSize_) {
+        release(alloc_, oldTable_, sizeof(Node*) * oldTableSize_);
+        oldTable_ = nullptr;
+        oldTableSize_ = 0;
+        migrated_ = 0;
+      }
+    }
+
+    void finishRehash()
+    {
+      if (oldTable_ != nullptr)
+        migrate(oldTableSize_);
+    }
+
     void size(size_t size)
     {
-      assert(size >= count_);
+      finishRehash();
+      Stats::of<Dictionary<T_Key, T_Value>>().resized();
 
-      Node** newTable = new Node*[size];
-      for (off_t i = 0; i < (ssize_t)size; ++i)
-        newTable[i] = nullptr;
+      Node** newTable = this->newTable(size);
 
       for (off_t i = 0; i < (ssize_t)tableSize_; ++i)
       {
         Node* node = table_[i];
         while(node != nullptr)
         {
-          int hashValue = hash<T_Key>(node->key);
-          off_t index = static_cast<off_t>(hashValue) % size;
+          uint64_t hashValue = hash<T_Key>(node->key);
+          off_t index = hashValue % size;
           Node* next = node->next;
           node->next = newTable[index];
           newTable[index] = node;
           node = next;
         }
       }
-      delete[] table_;
+      release(alloc_, table_, sizeof(Node*) * tableSize_);
       table_ = newTable;
       tableSize_ = size;
     }
 
-    void minSize(size_t size)
+    Node** newTable(size_t size)
     {
-      if (tableSize_ >= size)
-        return;
-      this->size(size);
+      Node** table = (Node**)allocateZeroed(alloc_, sizeof(Node*) * size);
+      Stats::of<Dictionary<T_Key, T_Value>>().allocated(sizeof(Node*) * size);
+      return table;
+    }
+
+    void* newNode()
+    {
+      size_t reserved = nodes_.reserved();
+      void* mem = nodes_.allocate();
+      if (nodes_.reserved() != reserved)
+        Stats::of<Dictionary<T_Key, T_Value>>().allocated(nodes_.reserved() - reserved);
+      return mem;
+    }
+
+    void deleteNode(Node* node)
+    {
+      node->~Node();
+      nodes_.release(node);
+    }
+
+    static void destroyNodes(Node** table, size_t from, size_t size)
+    {
+      for (size_t i = from; i < size; i++) {
+        Node* node = table[i];
+        while (node != nullptr) {
+          Node* next = node->next;
+          node->~Node();
+          node = next;
+        }
+      }
     }
   };
 
@@ -239,16 +537,11 @@ namespace Base {
   class DictionaryIter {
     public:
       DictionaryIter(Dictionary<T_Key, T_Value> const& dict) :
-        i_(0),
+        i_(-1),
         node_(nullptr),
         dict_(&dict)
       {
-        for (; i_ < (ssize_t)dict_->tableSize_; i_++) {
-          if (dict_->table_[i_] != nullptr) {
-            node_ = dict_->table_[i_];
-            return;
-          }
-        }
+        nextBucket();
       }
 
       void next()
@@ -259,13 +552,7 @@ namespace Base {
           node_ = node_->next;
           return;
         }
-        for (i_++; i_ < (ssize_t)dict_->tableSize_; i_++) {
-          if (dict_->table_[i_] != nullptr) {
-            node_ = dict_->table_[i_];
-            return;
-          }
-        }
-        node_ = nullptr;
+        nextBucket();
       }
 
       bool valid() const {
@@ -280,6 +567,23 @@ namespace Base {
       off_t i_;
       typename Dictionary<T_Key, T_Value>::Node* node_;
       Dictionary<T_Key, T_Value> const* dict_;
+
+      // Buckets of the current table, then any not yet moved out of the
+      // old one
+      void nextBucket()
+      {
+        ssize_t tableSize = dict_->tableSize_;
+        ssize_t total = tableSize;
+        if (dict_->oldTable_ != nullptr)
+          total += dict_->oldTableSize_ - dict_->migrated_;
+        for (i_++; i_ < total; i_++) {
+          node_ = i_ < tableSize ? dict_->table_[i_]
+                                 : dict_->oldTable_[dict_->migrated_ + i_ - tableSize];
+          if (node_ != nullptr)
+            return;
+        }
+        node_ = nullptr;
+      }
   };
 }
 
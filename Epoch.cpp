@@ -0,0 +1,216 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/Epoch.h"
+#include "Base/Fence.h"
+#include "Base/List.h"
+#include "Base/compat/sizes.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+using namespace Base;
+
+// Every thread that has ever read gets a slot, found again through a
+// thread_local and handed to a later thread once it exits. A slot holds
+// the global epoch seen when its thread entered its outermost guard, or 0
+// while the thread is outside any guard. Retired memory is stamped with
+// the epoch current when it was unlinked, and the epoch is then advanced,
+// so a reader that entered later cannot have seen it. Memory is freed
+// once every active slot is newer than its stamp.
+class Epoch::Domain {
+  public:
+    struct alignas(SZ_CACHE_LINE) Slot {
+      std::atomic<uint64_t> epoch;
+      std::atomic<bool> used;
+      size_t depth;
+      Slot* next;
+    };
+
+    // Never destroyed, so guards held by threads that outlive static
+    // destruction remain safe
+    static Domain& instance()
+    {
+      static Domain* domain = new Domain();
+      return *domain;
+    }
+
+    // The calling thread's slot, given back to the domain when it exits
+    static Slot* threadSlot()
+    {
+      struct Owner {
+        Slot* slot = nullptr;
+
+        ~Owner()
+        {
+          if (slot != nullptr)
+            instance().release(slot);
+        }
+      };
+      static thread_local Owner owner;
+      if (owner.slot == nullptr)
+        owner.slot = instance().acquire();
+      return owner.slot;
+    }
+
+    void enter(Slot* slot)
+    {
+      if (slot->depth++ > 0)
+        return;
+      slot->epoch.store(epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+      // Pairs with the heavy fence in collect: either the writer sees this
+      // slot or this reader sees the writer's unlink
+      Fence::light();
+    }
+
+    void exit(Slot* slot)
+    {
+      if (--slot->depth > 0)
+        return;
+      slot->epoch.store(0, std::memory_order_release);
+    }
+
+    Slot* acquire()
+    {
+      for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+        bool used = false;
+        if (!slot->used.load(std::memory_order_relaxed) &&
+            slot->used.compare_exchange_strong(used, true, std::memory_order_acquire))
+          return slot;
+      }
+      // new only guarantees max_align_t before C++17
+      void* mem = nullptr;
+      if (posix_memalign(&mem, SZ_CACHE_LINE, sizeof(Slot)) != 0)
+        throw std::bad_alloc();
+      Slot* slot = new (mem)Slot();
+      slot->epoch.store(0, std::memory_order_relaxed);
+      slot->used.store(true, std::memory_order_relaxed);
+      slot->depth = 0;
+      slot->next = slots_.load(std::memory_order_relaxed);
+      while (!slots_.compare_exchange_weak(slot->next, slot, std::memory_order_release))
+        ;
+      return slot;
+    }
+
+    void release(Slot* slot)
+    {
+      slot->used.store(false, std::memory_order_release);
+    }
+
+    void retire(void* const* ptrs, size_t count, void (*deleter)(void* ptr))
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      Fence::heavy();
+      uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < count; i++)
+        retired_.add(Retired{ptrs[i], deleter, epoch});
+      epoch_.fetch_add(1, std::memory_order_release);
+      if (retired_.count() >= collectAt_) {
+        collectLocked();
+        collectAt_ = retired_.count() * 2 + 64;
+      }
+    }
+
+    void collect()
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      collectLocked();
+    }
+
+    size_t pending()
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      return retired_.count();
+    }
+
+  private:
+    struct Retired {
+      void* ptr;
+      void (*deleter)(void* ptr);
+      uint64_t epoch;
+    };
+
+    std::atomic<uint64_t> epoch_;
+    std::atomic<Slot*> slots_;
+    std::mutex lock_;
+    List<Retired> retired_;
+    size_t collectAt_;
+
+    Domain() :
+      epoch_(1),
+      slots_(nullptr),
+      collectAt_(64)
+    {}
+
+    void collectLocked()
+    {
+      Fence::heavy();
+      uint64_t oldest = UINT64_MAX;
+      for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+        uint64_t epoch = slot->epoch.load(std::memory_order_acquire);
+        if (epoch != 0 && epoch < oldest)
+          oldest = epoch;
+      }
+      List<Retired> keep;
+      for (size_t i = 0; i < retired_.count(); i++) {
+        if (retired_[i].epoch < oldest)
+          retired_[i].deleter(retired_[i].ptr);
+        else
+          keep.add(retired_[i]);
+      }
+      retired_ = std::move(keep);
+    }
+};
+
+Epoch::Guard::Guard() :
+  active_(true)
+{
+  Domain::instance().enter(Domain::threadSlot());
+}
+
+Epoch::Guard::Guard(Guard&& guard) noexcept :
+  active_(guard.active_)
+{
+  guard.active_ = false;
+}
+
+Epoch::Guard::~Guard()
+{
+  if (active_)
+    Domain::instance().exit(Domain::threadSlot());
+}
+
+void Epoch::retire(void* ptr, void (*deleter)(void* ptr))
+{
+  Domain::instance().retire(&ptr, 1, deleter);
+}
+
+void Epoch::retire(void* const* ptrs, size_t count, void (*deleter)(void* ptr))
+{
+  Domain::instance().retire(ptrs, count, deleter);
+}
+
+void Epoch::collect()
+{
+  Domain::instance().collect();
+}
+
+size_t Epoch::pending()
+{
+  return Domain::instance().pending();
+}
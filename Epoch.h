@@ -0,0 +1,74 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Epoch_h
+#define __Base_Epoch_h
+
+#include <stddef.h>
+
+namespace Base
+{
+  // Epoch based reclamation for lock-free readers. A reader holds a Guard
+  // while it follows shared pointers; a writer that unlinks memory hands it
+  // to retire instead of freeing it, and it is freed only once every guard
+  // that could have seen it has been dropped. Entering and leaving a guard
+  // writes only the calling thread's own slot, so readers never contend.
+  // Guards nest and must be dropped on the thread that made them.
+  class Epoch {
+    public:
+      class Guard {
+        public:
+          Guard();
+          Guard(Guard&& guard) noexcept;
+          Guard(Guard const&) = delete;
+          Guard& operator= (Guard const&) = delete;
+          ~Guard();
+
+        private:
+          bool active_;
+      };
+
+      // Frees ptr with deleter once no current reader can still hold it.
+      // Safe to call from any thread, after ptr has been unlinked.
+      static void retire(void* ptr, void (*deleter)(void* ptr));
+
+      template <typename T>
+      static void retire(T* ptr)
+      {
+        retire((void*)ptr, [](void* ptr) { delete (T*)ptr; });
+      }
+
+      // Retires count pointers for the cost of one retire
+      static void retire(void* const* ptrs, size_t count, void (*deleter)(void* ptr));
+
+      template <typename T>
+      static void retire(T* const* ptrs, size_t count)
+      {
+        retire((void* const*)ptrs, count, [](void* ptr) { delete (T*)ptr; });
+      }
+
+      // Frees whatever retired memory is no longer visible to any reader;
+      // retire does this on its own as memory accumulates
+      static void collect();
+      // Retired allocations not yet freed
+      static size_t pending();
+
+    private:
+      class Domain;
+  };
+}
+
+#endif
@@ -15,11 +15,10 @@
  */
 
 #include "Base/Exception.h"
+#include "Base/StringBuilder.h"
 #include <string.h>
-#include <string>
 
 using namespace Base;
-using namespace std;
 
 #ifdef NDEBUG
 Exception::Exception(int err) :
@@ -38,7 +37,7 @@ Exception& Exception::operator= (Exception const& err)
 
 String Exception::toString() const
 {
-  return strerrno(err_);
+  return strerror(err_);
 }
 #else
 Exception::Exception(int err, const char *file, int line) :
@@ -63,6 +62,8 @@ Exception& Exception::operator= (Exception const& err)
 
 String Exception::toString() const
 {
-  return String(strerror(err_)) + " @ " + file_ + ":" + to_string(line_).c_str();
+  StringBuilder ret;
+  ret << strerror(err_) << " @ " << file_ << ':' << line_;
+  return ret.toString();
 }
 #endif
@@ -0,0 +1,47 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __Base_Fence_h
+#define __Base_Fence_h
+
+#include <atomic>
+
+namespace Base
+{
+  // Asymmetric fence pair for handshakes with a hot side and a rare side,
+  // where each side stores then loads what the other stores. Where the
+  // kernel supports it, heavy() interrupts every running thread of the
+  // process, so light() (run on the hot path) only has to stop the
+  // compiler reordering; otherwise both are full fences.
+  class Fence {
+    public:
+      static void light()
+      {
+        if (membarrier_.load(std::memory_order_relaxed))
+          std::atomic_signal_fence(std::memory_order_seq_cst);
+        else
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+
+      static void heavy();
+
+    private:
+      static std::atomic<bool> membarrier_;
+  };
+}
+
+#endif
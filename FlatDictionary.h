@@ -0,0 +1,490 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_FlatDictionary_h
+#define __Base_FlatDictionary_h
+
+#include "Base/Hash.h"
+#include "Base/List.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+namespace Base {
+  template <typename T_Key, typename T_Value>
+  class FlatDictionaryIter;
+
+  // Open addressing table with the same interface as Dictionary. Slots are
+  // split into groups of 16 that each have a byte of control data per slot
+  // (empty, deleted or 7 bits of the key's hash), so a probe compares a
+  // whole group against the hash in one step and only touches the key of
+  // slots that match.
+  template <typename T_Key, typename T_Value>
+  class FlatDictionary {
+  public:
+  class KVP {
+    public:
+      T_Key const& key;
+      T_Value& value;
+
+      KVP(T_Key const& key, T_Value& value) :
+        key(key),
+        value(value)
+      {}
+  };
+
+    FlatDictionary(size_t size = 4, Allocator* alloc = nullptr) :
+      count_(0),
+      capacity_(0),
+      growthLeft_(0),
+      ctrl_(nullptr),
+      slots_(nullptr),
+      alloc_(alloc)
+    {
+      allocate(capacityFor(size));
+    }
+
+    FlatDictionary(FlatDictionary<T_Key, T_Value> const& dict, Allocator* alloc = nullptr) :
+      count_(0),
+      capacity_(0),
+      growthLeft_(0),
+      ctrl_(nullptr),
+      slots_(nullptr),
+      alloc_(alloc)
+    {
+      allocate(capacityFor(dict.count_));
+      try {
+        for (auto it = dict.iter(); it.valid(); it.next()) {
+          size_t hashValue = hashOf(it.value().key);
+          size_t index = freeSlot(hashValue);
+          new (&slots_[index])Slot{it.value().key, it.value().value};
+          claim(index, hashValue);
+          count_ += 1;
+        }
+      } catch (...) {
+        destroy();
+        throw;
+      }
+    }
+
+    FlatDictionary(FlatDictionary<T_Key, T_Value>&& dict) noexcept :
+      count_(dict.count_),
+      capacity_(dict.capacity_),
+      growthLeft_(dict.growthLeft_),
+      ctrl_(dict.ctrl_),
+      slots_(dict.slots_),
+      alloc_(dict.alloc_)
+    {
+      dict.count_ = 0;
+      dict.capacity_ = 0;
+      dict.growthLeft_ = 0;
+      dict.ctrl_ = nullptr;
+      dict.slots_ = nullptr;
+    }
+
+    FlatDictionary<T_Key, T_Value>& operator= (FlatDictionary<T_Key, T_Value> const& dict)
+    {
+      if (&dict == this)
+        return *this;
+      Allocator* alloc = alloc_;
+      this->~FlatDictionary<T_Key, T_Value>();
+      new(this)FlatDictionary<T_Key, T_Value>(dict, alloc);
+      return *this;
+    }
+
+    FlatDictionary<T_Key, T_Value>& operator= (FlatDictionary<T_Key, T_Value>&& dict) noexcept
+    {
+      if (&dict == this)
+        return *this;
+      this->~FlatDictionary<T_Key, T_Value>();
+      new(this)FlatDictionary<T_Key, T_Value>(std::move(dict));
+      return *this;
+    }
+
+    void add(T_Key const& key, T_Value const& value)
+    {
+      emplace(key, value);
+    }
+
+    void add(T_Key&& key, T_Value&& value)
+    {
+      emplace(std::move(key), std::move(value));
+    }
+
+    // A key of another type is converted to T_Key once, and that is what
+    // gets checked, hashed and stored
+    template <typename K, typename... Args>
+    T_Value& emplace(K&& key, Args&&... args)
+    {
+      return emplaceKey(toKey(std::forward<K>(key)), std::forward<Args>(args)...);
+    }
+
+    // The value for key, adding factory()'s result first if key is absent.
+    // The key is hashed and searched for once.
+    template <typename F>
+    T_Value& getOrAdd(T_Key const& key, F&& factory)
+    {
+      size_t hashValue = hashOf(key);
+      off_t found = find(key, hashValue);
+      if (found >= 0)
+        return slots_[found].value;
+      if (growthLeft_ == 0)
+        rehash();
+      size_t index = freeSlot(hashValue);
+      new (&slots_[index])Slot{key, factory()};
+      claim(index, hashValue);
+      count_ += 1;
+      return slots_[index].value;
+    }
+
+    // Removes key's entry, if any; true when there was one
+    bool remove(T_Key const& key)
+    {
+      off_t index = find(key);
+      if (index < 0)
+        return false;
+      slots_[index].~Slot();
+      off_t group = index & ~(off_t)(GroupSize - 1);
+      if (Group(ctrl_ + group).matchEmpty() != 0) {
+        ctrl_[index] = Empty;
+        growthLeft_ += 1;
+      } else {
+        ctrl_[index] = Deleted;
+      }
+      count_ -= 1;
+      return true;
+    }
+
+    bool containsKey(T_Key const& key) const
+    {
+      return find(key) >= 0;
+    }
+
+    size_t count() const {
+      return count_;
+    }
+
+    Base::List<T_Key> keys() const {
+      Base::List<T_Key> keys_ret(count());
+      for (off_t i = 0; i < (ssize_t)capacity_; i++) {
+        if (ctrl_[i] >= 0)
+          keys_ret.add(slots_[i].key);
+      }
+      return keys_ret;
+    }
+
+    T_Value& operator[] (T_Key const& key) const
+    {
+      off_t index = find(key);
+      assert(index >= 0);
+      return slots_[index].value;
+    }
+
+    // Key's value, or nullptr when it is absent; saves the second search
+    // of a containsKey then operator[]
+    T_Value* tryGet(T_Key const& key) const
+    {
+      off_t index = find(key);
+      return index >= 0 ? &slots_[index].value : nullptr;
+    }
+
+    FlatDictionaryIter<T_Key, T_Value> iter() const {
+      return FlatDictionaryIter<T_Key, T_Value>(*this);
+    }
+
+    Allocator* allocator() const {
+      return alloc_;
+    }
+
+    ~FlatDictionary()
+    {
+      destroy();
+    }
+
+  private:
+    static constexpr size_t GroupSize = 16;
+    static constexpr int8_t Empty = -128;
+    static constexpr int8_t Deleted = -2;
+
+    struct Slot {
+      T_Key key;
+      T_Value value;
+    };
+
+#ifdef __SSE2__
+    struct Group {
+      __m128i ctrl;
+
+      Group(int8_t const* ctrl) :
+        ctrl(_mm_loadu_si128((__m128i const*)ctrl))
+      {}
+
+      uint32_t match(int8_t h2) const
+      {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+      }
+
+      uint32_t matchEmpty() const
+      {
+        return match(Empty);
+      }
+
+      uint32_t matchEmptyOrDeleted() const
+      {
+        return _mm_movemask_epi8(ctrl);
+      }
+    };
+#else
+    struct Group {
+      int8_t const* ctrl;
+
+      Group(int8_t const* ctrl) :
+        ctrl(ctrl)
+      {}
+
+      uint32_t match(int8_t h2) const
+      {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GroupSize; i++)
+          mask |= (uint32_t)(ctrl[i] == h2) << i;
+        return mask;
+      }
+
+      uint32_t matchEmpty() const
+      {
+        return match(Empty);
+      }
+
+      uint32_t matchEmptyOrDeleted() const
+      {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GroupSize; i++)
+          mask |= (uint32_t)(ctrl[i] < 0) << i;
+        return mask;
+      }
+    };
+#endif
+
+    size_t count_;
+    size_t capacity_;
+    size_t growthLeft_;
+    int8_t* ctrl_;
+    Slot* slots_;
+    Allocator* alloc_;
+
+    friend class FlatDictionaryIter<T_Key, T_Value>;
+
+    static size_t hashOf(T_Key const& key)
+    {
+      return (size_t)hash<T_Key>(key);
+    }
+
+    template <typename K>
+    static K&& toKey(K&& key,
+      typename std::enable_if<std::is_same<typename std::decay<K>::type, T_Key>::value>::type* = nullptr)
+    {
+      return std::forward<K>(key);
+    }
+
+    template <typename K>
+    static T_Key toKey(K&& key,
+      typename std::enable_if<!std::is_same<typename std::decay<K>::type, T_Key>::value>::type* = nullptr)
+    {
+      return T_Key(std::forward<K>(key));
+    }
+
+    // key is a T_Key, so checking, hashing and storing it converts nothing
+    template <typename K, typename... Args>
+    T_Value& emplaceKey(K&& key, Args&&... args)
+    {
+      assert(!containsKey(key));
+      if (growthLeft_ == 0)
+        rehash();
+      size_t hashValue = hashOf(key);
+      size_t index = freeSlot(hashValue);
+      new (&slots_[index])Slot{
+        T_Key(std::forward<K>(key)),
+        T_Value(std::forward<Args>(args)...)
+      };
+      claim(index, hashValue);
+      count_ += 1;
+      return slots_[index].value;
+    }
+
+    static int8_t h2(size_t hashValue)
+    {
+      return (int8_t)(hashValue & 0x7F);
+    }
+
+    static size_t maxLoad(size_t capacity)
+    {
+      return capacity - capacity / 8;
+    }
+
+    static size_t capacityFor(size_t count)
+    {
+      size_t capacity = GroupSize;
+      while (maxLoad(capacity) < count)
+        capacity *= 2;
+      return capacity;
+    }
+
+    off_t find(T_Key const& key) const
+    {
+      return find(key, hashOf(key));
+    }
+
+    off_t find(T_Key const& key, size_t hashValue) const
+    {
+      if (capacity_ == 0)
+        return -1;
+      size_t groupMask = capacity_ / GroupSize - 1;
+      size_t group = (hashValue >> 7) & groupMask;
+      for (size_t step = 1; step <= groupMask + 1; step++) {
+        Group g(ctrl_ + group * GroupSize);
+        for (uint32_t mask = g.match(h2(hashValue)); mask != 0; mask &= mask - 1) {
+          size_t index = group * GroupSize + __builtin_ctz(mask);
+          if (slots_[index].key == key)
+            return index;
+        }
+        if (g.matchEmpty() != 0)
+          return -1;
+        group = (group + step) & groupMask;
+      }
+      return -1;
+    }
+
+    // The first empty or deleted slot on hashValue's probe sequence. It
+    // stays free until claim, so a slot whose construction throws is never
+    // taken for a full one.
+    size_t freeSlot(size_t hashValue) const
+    {
+      size_t groupMask = capacity_ / GroupSize - 1;
+      size_t group = (hashValue >> 7) & groupMask;
+      for (size_t step = 1;; step++) {
+        uint32_t mask = Group(ctrl_ + group * GroupSize).matchEmptyOrDeleted();
+        if (mask != 0)
+          return group * GroupSize + __builtin_ctz(mask);
+        group = (group + step) & groupMask;
+      }
+    }
+
+    // Marks a slot from freeSlot full, once its entry has been constructed
+    void claim(size_t index, size_t hashValue)
+    {
+      if (ctrl_[index] == Empty)
+        growthLeft_ -= 1;
+      ctrl_[index] = h2(hashValue);
+    }
+
+    void allocate(size_t capacity)
+    {
+      int8_t* ctrl = (int8_t*)Base::allocate(alloc_, capacity);
+      Slot* slots;
+      try {
+        slots = (Slot*)Base::allocate(alloc_, sizeof(Slot) * capacity);
+      } catch (...) {
+        release(alloc_, ctrl, capacity);
+        throw;
+      }
+      memset(ctrl, Empty, capacity);
+      ctrl_ = ctrl;
+      slots_ = slots;
+      capacity_ = capacity;
+      growthLeft_ = maxLoad(capacity);
+    }
+
+    void rehash()
+    {
+      int8_t* oldCtrl = ctrl_;
+      Slot* oldSlots = slots_;
+      size_t oldCapacity = capacity_;
+      //reclaim tombstones in place unless the table is actually filling up
+      if (count_ * 2 < maxLoad(capacity_))
+        allocate(capacity_);
+      else
+        allocate(capacity_ == 0 ? GroupSize : capacity_ * 2);
+      for (off_t i = 0; i < (ssize_t)oldCapacity; i++) {
+        if (oldCtrl[i] < 0)
+          continue;
+        size_t hashValue = hashOf(oldSlots[i].key);
+        size_t index = freeSlot(hashValue);
+        new (&slots_[index])Slot(std::move_if_noexcept(oldSlots[i]));
+        claim(index, hashValue);
+        oldSlots[i].~Slot();
+      }
+      release(alloc_, oldCtrl, oldCapacity);
+      release(alloc_, oldSlots, sizeof(Slot) * oldCapacity);
+    }
+
+    void destroy()
+    {
+      for (off_t i = 0; i < (ssize_t)capacity_; i++) {
+        if (ctrl_[i] >= 0)
+          slots_[i].~Slot();
+      }
+      release(alloc_, ctrl_, capacity_);
+      release(alloc_, slots_, sizeof(Slot) * capacity_);
+      ctrl_ = nullptr;
+      slots_ = nullptr;
+      capacity_ = 0;
+      count_ = 0;
+      growthLeft_ = 0;
+    }
+  };
+
+  template <typename T_Key, typename T_Value>
+  class FlatDictionaryIter {
+    public:
+      FlatDictionaryIter(FlatDictionary<T_Key, T_Value> const& dict) :
+        i_(-1),
+        dict_(&dict)
+      {
+        next();
+      }
+
+      void next()
+      {
+        for (i_++; i_ < (ssize_t)dict_->capacity_; i_++) {
+          if (dict_->ctrl_[i_] >= 0)
+            return;
+        }
+      }
+
+      bool valid() const {
+        return i_ < (ssize_t)dict_->capacity_;
+      }
+
+      typename FlatDictionary<T_Key, T_Value>::KVP value() const
+      {
+        assert(valid());
+        return typename FlatDictionary<T_Key, T_Value>::KVP(
+          dict_->slots_[i_].key, dict_->slots_[i_].value);
+      }
+    private:
+      off_t i_;
+      FlatDictionary<T_Key, T_Value> const* dict_;
+  };
+}
+
+#endif
@@ -1,37 +1,171 @@
-#include "Base/Hash.h"
-
-template<>
-int Base::hash<uint32_t>(uint32_t const& value)
-{
-  return static_cast<int>(value);
-}
-
-template<>
-int Base::hash<int32_t>(int32_t const& value)
-{
-  return static_cast<int>(value);
-}
-
-template<>
-int Base::hash<uint16_t>(uint16_t const& value)
-{
-  return static_cast<int>(value);
-}
-
-template<>
-int Base::hash<int16_t>(int16_t const& value)
-{
-  return static_cast<int>(value);
-}
-
-template<>
-int Base::hash<uint8_t>(uint8_t const& value)
-{
-  return static_cast<int>(value);
-}
-
-template<>
-int Base::hash<int8_t>(int8_t const& value)
-{
-  return static_cast<int>(value);
-}
\ No newline at end of file
+#include "Base/Hash.h"
+
+#include <string.h>
+#include <chrono>
+#include <random>
+
+using namespace Base;
+
+static const uint64_t secret[4] = {
+  0xa0761d6478bd642full,
+  0xe7037ed1a0b428dbull,
+  0x8ebc6af09c88c6e3ull,
+  0x589965cc75374cc3ull
+};
+
+static inline void multiply(uint64_t& a, uint64_t& b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)a * b;
+  a = (uint64_t)r;
+  b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  a = lo;
+  b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+  multiply(a, b);
+  return a ^ b;
+}
+
+static inline uint64_t read64(uint8_t const* p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t read32(uint8_t const* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t Hash::seed_ = 0;
+// keyFor(0), as a constant so that hashes made during static
+// initialization, before any code here could run, already use it
+uint64_t Hash::key_ = 0x1ff5c2923a788d2cull;
+
+// The starting state of bytes(), derived from the seed once when it is set
+// rather than on every call
+static uint64_t keyFor(uint64_t seed)
+{
+  return seed ^ mix(seed ^ secret[0], secret[1]);
+}
+
+uint64_t Hash::bytes(void const* data, size_t length)
+{
+  uint8_t const* p = (uint8_t const*)data;
+  uint64_t seed = key_;
+  uint64_t a;
+  uint64_t b;
+  if (length <= 16) {
+    if (length >= 4) {
+      size_t mid = (length >> 3) << 2;
+      a = (read32(p) << 32) | read32(p + mid);
+      b = (read32(p + length - 4) << 32) | read32(p + length - 4 - mid);
+    } else if (length > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = length;
+    if (i > 48) {
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+      do {
+        seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+        seed1 = mix(read64(p + 16) ^ secret[2], read64(p + 24) ^ seed1);
+        seed2 = mix(read64(p + 32) ^ secret[3], read64(p + 40) ^ seed2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16) {
+      seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    a = read64(p + i - 16);
+    b = read64(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  multiply(a, b);
+  return mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+void Hash::setSeed(uint64_t seed)
+{
+  seed_ = seed;
+  key_ = keyFor(seed);
+}
+
+void Hash::randomizeSeed()
+{
+  std::random_device device;
+  uint64_t seed = ((uint64_t)device() << 32) | device();
+  seed ^= (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+  setSeed(integer(seed));
+}
+
+template<>
+uint64_t Base::hash<uint64_t>(uint64_t const& value)
+{
+  return Hash::integer(value);
+}
+
+template<>
+uint64_t Base::hash<int64_t>(int64_t const& value)
+{
+  return Hash::integer(static_cast<uint64_t>(value));
+}
+
+template<>
+uint64_t Base::hash<uint32_t>(uint32_t const& value)
+{
+  return Hash::integer(value);
+}
+
+template<>
+uint64_t Base::hash<int32_t>(int32_t const& value)
+{
+  return Hash::integer(static_cast<uint64_t>(value));
+}
+
+template<>
+uint64_t Base::hash<uint16_t>(uint16_t const& value)
+{
+  return Hash::integer(value);
+}
+
+template<>
+uint64_t Base::hash<int16_t>(int16_t const& value)
+{
+  return Hash::integer(static_cast<uint64_t>(value));
+}
+
+template<>
+uint64_t Base::hash<uint8_t>(uint8_t const& value)
+{
+  return Hash::integer(value);
+}
+
+template<>
+uint64_t Base::hash<int8_t>(int8_t const& value)
+{
+  return Hash::integer(static_cast<uint64_t>(value));
+}
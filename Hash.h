@@ -17,32 +17,87 @@
 #ifndef __Base_Hash_h
 #define __Base_Hash_h
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace Base
 {
+  // 64-bit hashing used by the hashed containers. Results are fully mixed,
+  // so tables may take any bits of them. Everything is keyed by a process
+  // wide seed, which is zero (reproducible) unless setSeed or randomizeSeed
+  // is called; either must happen before any hashed container is filled.
+  class Hash {
+    public:
+      static uint64_t integer(uint64_t value)
+      {
+        value += seed_ + 0x9E3779B97F4A7C15ull;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+      }
+
+      static uint64_t bytes(void const* data, size_t length);
+
+      static uint64_t seed()
+      {
+        return seed_;
+      }
+
+      static void setSeed(uint64_t seed);
+      static void randomizeSeed();
+
+    private:
+      static uint64_t seed_;
+      static uint64_t key_;
+  };
+
+  template<typename T>
+  struct Hasher {
+    static uint64_t hash(T const& value)
+    {
+      return value.hash();
+    }
+  };
+
+  template<typename T>
+  struct Hasher<T*> {
+    static uint64_t hash(T* const& value)
+    {
+      return Hash::integer(reinterpret_cast<uintptr_t>(value));
+    }
+  };
+
+  // The type a hashed container keyed by T is probed with when given some
+  // other key type, so that e.g. a String table can be searched by a
+  // char const* without building a String. A specialisation must hash to
+  // the same value as the T it compares equal to.
+  template<typename T>
+  struct LookupKey {
+    typedef T type;
+  };
+
   template<typename T>
-  int hash(T const& value)
+  uint64_t hash(T const& value)
   {
-    return value.hash();
+    return Hasher<T>::hash(value);
   }
 
   template<>
-  int hash<uint32_t>(uint32_t const& value);
+  uint64_t hash<uint64_t>(uint64_t const& value);
   template<>
-  int hash<int32_t>(int32_t const& value);
+  uint64_t hash<int64_t>(int64_t const& value);
   template<>
-  int hash<uint16_t>(uint16_t const& value);
+  uint64_t hash<uint32_t>(uint32_t const& value);
   template<>
-  int hash<int16_t>(int16_t const& value);
+  uint64_t hash<int32_t>(int32_t const& value);
   template<>
-  int hash<uint8_t>(uint8_t const& value);
+  uint64_t hash<uint16_t>(uint16_t const& value);
   template<>
-  int hash<int8_t>(int8_t const& value);
-
-  class Hash {
-
-  };
+  uint64_t hash<int16_t>(int16_t const& value);
+  template<>
+  uint64_t hash<uint8_t>(uint8_t const& value);
+  template<>
+  uint64_t hash<int8_t>(int8_t const& value);
 }
 
 #endif
@@ -17,10 +17,17 @@
 #ifndef __Base_List_h
 #define __Base_List_h
 
+#include "Base/Allocator.h"
+#include "Base/Relocatable.h"
+#include "Base/Sort.h"
+#include "Base/Stats.h"
 #include "Base/compat/stdint.h"
 #include <algorithm>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <utility>
 
 namespace Base
 {
@@ -30,62 +37,96 @@ namespace Base
   template <typename T>
   class List {
     public:
-      List(T const* items, size_t count, size_t containerSize = 0) :
+      List(T const* items, size_t count, size_t containerSize = 0,
+           Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(count),
-        size_(std::max(count, containerSize))
+        size_(std::max(count, containerSize)),
+        alloc_(alloc)
       {
         assert(items != nullptr);
-        items_ = (T*)malloc(sizeof(T) * size_);
-        if (items_ == nullptr)
-          throw std::bad_alloc();
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<List<T>>().allocated(sizeof(T) * size_);
+        Stats::of<List<T>>().copied(count);
         for (off_t i = 0; i < (ssize_t)count; ++i) {
           try {
             new (&items_[i])T(items[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++)
               items_[j].~T();
-            free(items_);
+            release(alloc_, items_, sizeof(T) * size_);
             throw;
           }
         }
       }
 
-      List(size_t containerSize = 0) :
+      List(size_t containerSize = 0, Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(0),
-        size_(containerSize)
+        size_(containerSize),
+        alloc_(alloc)
       {
         if (size_ > 0) {
-          items_ = (T*)malloc(sizeof(T) * size_);
-          if (items_ == nullptr)
-            throw std::bad_alloc();
+          items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+          Stats::of<List<T>>().allocated(sizeof(T) * size_);
         }
       }
 
-      List(List<T> const& value) :
+      List(List<T> const& value, Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(value.count_),
-        size_(value.size_)
+        size_(value.size_),
+        alloc_(alloc)
       {
-        items_ = (T*)malloc(sizeof(T) * size_);
-        if (items_ == nullptr)
-          throw std::bad_alloc();
+        if (size_ == 0)
+          return;
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<List<T>>().allocated(sizeof(T) * size_);
+        Stats::of<List<T>>().copied(count_);
         for (off_t i = 0; i < (ssize_t)count_; ++i) {
           try {
             new (&items_[i])T(value.items_[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++)
               items_[j].~T();
-            free(items_);
+            release(alloc_, items_, sizeof(T) * size_);
             throw;
           }
         }
       }
 
+      List(List<T>&& value) noexcept :
+        items_(value.items_),
+        count_(value.count_),
+        size_(value.size_),
+        alloc_(value.alloc_)
+      {
+        value.items_ = nullptr;
+        value.count_ = 0;
+        value.size_ = 0;
+      }
+
+      List<T>& operator= (List<T>&& value) noexcept
+      {
+        if (&value == this)
+          return *this;
+        for (off_t i = 0; i < (ssize_t)count_; i++)
+          items_[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
+        items_ = value.items_;
+        count_ = value.count_;
+        size_ = value.size_;
+        alloc_ = value.alloc_;
+        value.items_ = nullptr;
+        value.count_ = 0;
+        value.size_ = 0;
+        return *this;
+      }
+
       List<T>& operator= (List<T> const& value)
       {
         minSize(value.count_);
+        Stats::of<List<T>>().copied(value.count_);
         off_t i;
         for (i = 0; i < (ssize_t)count_ && i < (ssize_t)value.count_; ++i)
           items_[i] = value.items_[i];
@@ -105,10 +146,21 @@ namespace Base
       }
 
       void add(T const& item)
+      {
+        emplace(item);
+      }
+
+      void add(T&& item)
+      {
+        emplace(std::move(item));
+      }
+
+      template <typename... Args>
+      T& emplace(Args&&... args)
       {
         minSize(count_ + 1);
-        new (&items_[count_])T(item);
-        count_++;
+        new (&items_[count_])T(std::forward<Args>(args)...);
+        return items_[count_++];
       }
 
       void add(T const* items, size_t count = 1)
@@ -142,12 +194,64 @@ namespace Base
         count_ += items.count_;
       }
 
+      // Appends count items built in place by construct(items, count), for
+      // producers that fill a whole block at once, possibly in parallel.
+      // construct must build all of the items, or none before throwing.
+      template <typename F>
+      void addInPlace(size_t count, F construct)
+      {
+        minSize(count_ + count);
+        construct(items_ + count_, count);
+        count_ += count;
+      }
+
+      void insert(off_t index, T const& item)
+      {
+        emplaceAt(index, item);
+      }
+
+      void insert(off_t index, T&& item)
+      {
+        emplaceAt(index, std::move(item));
+      }
+
+      template <typename... Args>
+      T& emplaceAt(off_t index, Args&&... args)
+      {
+        assert(index >= 0 && index <= (ssize_t)count_);
+        // Built up front since args may refer to an item that is about to move
+        T item(std::forward<Args>(args)...);
+        minSize(count_ + 1);
+        if (Relocatable<T>::value) {
+          memmove((void*)&items_[index + 1], (void*)&items_[index],
+                  sizeof(T) * (count_ - index));
+          new (&items_[index])T(std::move(item));
+        } else if (index == (ssize_t)count_) {
+          new (&items_[index])T(std::move(item));
+        } else {
+          new (&items_[count_])T(std::move(items_[count_ - 1]));
+          for (off_t i = count_ - 1; i > index; i--)
+            items_[i] = std::move(items_[i - 1]);
+          items_[index] = std::move(item);
+        }
+        count_++;
+        return items_[index];
+      }
+
       void remove(off_t index, size_t length = 1)
       {
         assert(index + length <= count_);
         if (length == 0) return;
+        if (Relocatable<T>::value) {
+          for (off_t i = index; i < (ssize_t)(index + length); i++)
+            items_[i].~T();
+          memmove((void*)&items_[index], (void*)&items_[index + length],
+                  sizeof(T) * (count_ - index - length));
+          count_ -= length;
+          return;
+        }
         for (off_t i = index; i < (ssize_t)(count_ - length); ++i)
-          items_[i] = items_[i + length];
+          items_[i] = std::move(items_[i + length]);
         for (off_t i = count_ - length; i < (ssize_t)count_; i++)
           items_[i].~T();
         count_ -= length;
@@ -180,22 +284,36 @@ namespace Base
       {
         assert(size >= count_);
         if (size_ == size) return;
-        T* newItems = (T*)malloc(sizeof(T) * size);
-        if (newItems == nullptr)
-          throw std::bad_alloc();
+        Stats::of<List<T>>().resized();
+        Stats::of<List<T>>().allocated(sizeof(T) * size);
+        if (size == 0) {
+          // Only an empty list gets here, so there is nothing to move
+          release(alloc_, items_, sizeof(T) * size_);
+          items_ = nullptr;
+          size_ = 0;
+          return;
+        }
+        if (Relocatable<T>::value) {
+          items_ = (T*)reallocate(alloc_, (void*)items_, sizeof(T) * size_,
+                                  sizeof(T) * size);
+          size_ = size;
+          return;
+        }
+        T* newItems = (T*)allocate(alloc_, sizeof(T) * size);
+        Stats::of<List<T>>().copied(count_);
         for (off_t i = 0; i < (ssize_t)count_; ++i) {
           try {
-            new (&newItems[i])T(items_[i]);
+            new (&newItems[i])T(std::move_if_noexcept(items_[i]));
           } catch (...) {
             for (off_t j = 0; j < i; j++)
               newItems[j].~T();
-            free(newItems);
+            release(alloc_, newItems, sizeof(T) * size);
             throw;
           }
         }
         for (off_t i = 0; i < (ssize_t)count_; i++)
           items_[i].~T();
-        free(items_);
+        release(alloc_, items_, sizeof(T) * size_);
         items_ = newItems;
         size_ = size;
       }
@@ -210,6 +328,31 @@ namespace Base
           return items_[index];
       }
 
+      // Sorts in place, not stably: pattern-defeating quicksort, or radix
+      // sort for integers and Strings when no comparison is given
+      void sort()
+      {
+        DefaultSort<T>::sort(items_, count_);
+      }
+
+      template <typename C>
+      void sort(C compare)
+      {
+        sortRange(items_, count_, compare);
+      }
+
+      // Sorts in place keeping equal items in their original order
+      void stableSort()
+      {
+        DefaultSort<T>::stableSort(items_, count_);
+      }
+
+      template <typename C>
+      void stableSort(C compare)
+      {
+        stableSortRange(items_, count_, compare);
+      }
+
       ListIter<T> iter() const
       {
         return ListIter<T>(*this);
@@ -229,6 +372,13 @@ namespace Base
         return ret;
       }
 
+      List<T> operator+(T&& value) const
+      {
+        List<T> ret(*this);
+        ret.add(std::move(value));
+        return ret;
+      }
+
       List<T>& operator+= (List<T> const& value)
       {
         add(value);
@@ -241,11 +391,22 @@ namespace Base
         return *this;
       }
 
+      List<T>& operator+= (T&& value)
+      {
+        add(std::move(value));
+        return *this;
+      }
+
+      Allocator* allocator() const
+      {
+        return alloc_;
+      }
+
       ~List()
       {
         for (off_t i = 0; i < (ssize_t)count_; i++)
           items_[i].~T();
-        free(items_);
+        release(alloc_, items_, sizeof(T) * size_);
       }
 
     private:
@@ -254,6 +415,7 @@ namespace Base
       T* items_;
       size_t count_;
       size_t size_;
+      Allocator* alloc_;
 
       void minSize(size_t size)
       {
@@ -264,6 +426,10 @@ namespace Base
       }
   };
 
+  // A List holds no pointers into itself, so it relocates as bytes
+  template <typename T>
+  struct Relocatable<List<T>> : std::true_type {};
+
   template <typename T>
   class ListIter {
     public:
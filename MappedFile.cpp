@@ -0,0 +1,151 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/MappedFile.h"
+#include "Base/Allocator.h"
+#include "Base/Exception.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace Base;
+
+MappedFile::MappedFile(char const* path) :
+  data_(nullptr),
+  length_(0),
+  mapped_(false)
+{
+  int fd = neg_except(int, ::open, path, O_RDONLY | O_CLOEXEC);
+  try {
+    load(fd);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  // A mapping outlives its descriptor
+  ::close(fd);
+}
+
+MappedFile::MappedFile(int fd) :
+  data_(nullptr),
+  length_(0),
+  mapped_(false)
+{
+  load(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& file) noexcept :
+  data_(file.data_),
+  length_(file.length_),
+  mapped_(file.mapped_)
+{
+  file.data_ = nullptr;
+  file.length_ = 0;
+  file.mapped_ = false;
+}
+
+MappedFile& MappedFile::operator= (MappedFile&& file) noexcept
+{
+  if (&file == this)
+    return *this;
+  close();
+  data_ = file.data_;
+  length_ = file.length_;
+  mapped_ = file.mapped_;
+  file.data_ = nullptr;
+  file.length_ = 0;
+  file.mapped_ = false;
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+void MappedFile::evict(size_t begin, size_t end) const
+{
+  if (!mapped_)
+    return;
+  size_t page = sysconf(_SC_PAGESIZE);
+  begin = (begin + page - 1) / page * page;
+  end = std::min(end, length_) / page * page;
+  if (begin >= end)
+    return;
+  // Dropping clean pages of a private read-only file mapping only loses
+  // the cached copy
+  madvise(data_ + begin, end - begin, MADV_DONTNEED);
+}
+
+void MappedFile::load(int fd)
+{
+  struct stat info;
+  neg_except(int, fstat, fd, &info);
+  // Files under /proc and /sys report a size of 0 whatever they hold, so
+  // only a nonzero size is mapped and anything else is read
+  if (S_ISREG(info.st_mode) && info.st_size > 0) {
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      madvise(data, info.st_size, MADV_SEQUENTIAL);
+      data_ = (char*)data;
+      length_ = info.st_size;
+      mapped_ = true;
+      return;
+    }
+  }
+
+  size_t size = S_ISREG(info.st_mode) && info.st_size > 0 ? info.st_size + 1 : SZ_64K;
+  char* buffer = (char*)allocate(nullptr, size);
+  size_t length = 0;
+  for (;;) {
+    if (length == size) {
+      buffer = (char*)reallocate(nullptr, buffer, size, size * 2);
+      size *= 2;
+    }
+    ssize_t got = ::read(fd, buffer + length, size - length);
+    if (got == 0)
+      break;
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      int err = errno;
+      release(nullptr, buffer, size);
+      errno = err;
+      throw_errno;
+    }
+    length += got;
+  }
+  data_ = (char*)reallocate(nullptr, buffer, size, length > 0 ? length : 1);
+  length_ = length;
+}
+
+void MappedFile::close()
+{
+  if (data_ == nullptr)
+    return;
+  if (mapped_)
+    munmap(data_, length_);
+  else
+    release(nullptr, data_, length_ > 0 ? length_ : 1);
+  data_ = nullptr;
+  length_ = 0;
+  mapped_ = false;
+}
@@ -0,0 +1,116 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_MappedFile_h
+#define __Base_MappedFile_h
+
+#include "Base/String.h"
+#include "Base/StringView.h"
+#include "Base/compat/sizes.h"
+
+namespace Base
+{
+  class MappedFileLineIter;
+
+  // Read-only view of a whole file without copying it. Regular files are
+  // mapped with a sequential access hint; pipes, terminals, files that
+  // report no size (as under /proc) and anything else that cannot be
+  // mapped are read into memory instead. Views and
+  // lines taken from it are valid for the life of the MappedFile.
+  // Errors throw Exception with the failing errno.
+  class MappedFile {
+    public:
+      explicit MappedFile(char const* path);
+      explicit MappedFile(String const& path) : MappedFile(path.c_str()) {}
+      // Reads or maps an open descriptor, which stays open and owned by
+      // the caller (e.g. 0 for stdin)
+      explicit MappedFile(int fd);
+      MappedFile(MappedFile&& file) noexcept;
+      MappedFile& operator= (MappedFile&& file) noexcept;
+      MappedFile(MappedFile const&) = delete;
+      MappedFile& operator= (MappedFile const&) = delete;
+      ~MappedFile();
+
+      StringView view() const { return StringView(data_, length_); }
+      size_t length() const { return length_; }
+      // False when the content was read into memory
+      bool isMapped() const { return mapped_; }
+
+      // Lines of the file, as StringView::lines. When mapped, pages the
+      // iterator has moved well past are dropped from memory (they are
+      // reread from the file if touched again), so resident memory stays
+      // bounded however large the file is.
+      MappedFileLineIter lines() const;
+
+      // Drops the mapped pages wholly inside [begin, end) from memory;
+      // their content is unchanged and faults back in on access
+      void evict(size_t begin, size_t end) const;
+
+    private:
+      char* data_;
+      size_t length_;
+      bool mapped_;
+
+      void load(int fd);
+      void close();
+  };
+
+  class MappedFileLineIter {
+    public:
+      MappedFileLineIter(MappedFile const& file) :
+        file_(&file),
+        lines_(file.view()),
+        evicted_(0)
+      {}
+
+      bool valid() const {
+        return lines_.valid();
+      }
+
+      StringView value() const {
+        return lines_.value();
+      }
+
+      size_t offset() const {
+        return lines_.offset();
+      }
+
+      void next()
+      {
+        lines_.next();
+        if (file_->isMapped() && lines_.valid() && lines_.offset() >= evicted_ + 2 * EvictWindow) {
+          file_->evict(evicted_, evicted_ + EvictWindow);
+          evicted_ += EvictWindow;
+        }
+      }
+
+    private:
+      // Pages are dropped a window at a time, one window behind the
+      // current line, so recent lines stay resident
+      static constexpr size_t EvictWindow = SZ_32M;
+
+      MappedFile const* file_;
+      StringLineIter lines_;
+      size_t evicted_;
+  };
+
+  inline MappedFileLineIter MappedFile::lines() const
+  {
+    return MappedFileLineIter(*this);
+  }
+}
+
+#endif
@@ -0,0 +1,249 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_MpmcQueue_h
+#define __Base_MpmcQueue_h
+
+#include "Base/Fence.h"
+#include "Base/compat/sizes.h"
+#include "Base/compat/stdint.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <new>
+#include <utility>
+
+namespace Base
+{
+  // Bounded multi-producer/multi-consumer ring (Vyukov). Each cell carries
+  // a sequence number saying whether it is ready to be written or read for
+  // a given lap, so producers and consumers only contend on their own
+  // position counter. The blocking calls retry the try path, yielding, and
+  // only take the lock to sleep when the ring is full or empty. Sleepers
+  // pay for the fence that keeps wakeups from being lost, so a push or
+  // pop with nobody asleep only checks a waiter count.
+  template <typename T>
+  class MpmcQueue {
+    public:
+      MpmcQueue(size_t containerSize) :
+        cells_(nullptr),
+        size_(2),
+        enqueuePos_(0),
+        dequeuePos_(0),
+        waitingProducers_(0),
+        waitingConsumers_(0)
+      {
+        assert(containerSize > 0);
+        while (size_ < containerSize)
+          size_ *= 2;
+        cells_ = (Cell*)malloc(sizeof(Cell) * size_);
+        if (cells_ == nullptr)
+          throw std::bad_alloc();
+        for (size_t i = 0; i < size_; i++)
+          new (&cells_[i].sequence)std::atomic<size_t>(i);
+      }
+
+      MpmcQueue(MpmcQueue<T> const&) = delete;
+      MpmcQueue<T>& operator= (MpmcQueue<T> const&) = delete;
+
+      bool tryEnqueue(T const& item)
+      {
+        return tryEmplace(item);
+      }
+
+      bool tryEnqueue(T&& item)
+      {
+        if (!push(std::move(item)))
+          return false;
+        wake(waitingConsumers_, notEmpty_);
+        return true;
+      }
+
+      template <typename... Args>
+      bool tryEmplace(Args&&... args)
+      {
+        if (!push(T(std::forward<Args>(args)...)))
+          return false;
+        wake(waitingConsumers_, notEmpty_);
+        return true;
+      }
+
+      bool tryDequeue(T& item)
+      {
+        if (!pop(item))
+          return false;
+        wake(waitingProducers_, notFull_);
+        return true;
+      }
+
+      void enqueue(T const& item)
+      {
+        emplace(item);
+      }
+
+      void enqueue(T&& item)
+      {
+        emplace(std::move(item));
+      }
+
+      template <typename... Args>
+      void emplace(Args&&... args)
+      {
+        T item(std::forward<Args>(args)...);
+        for (int i = 0; i < SpinCount; i++) {
+          if (tryEnqueue(std::move(item)))
+            return;
+          std::this_thread::yield();
+        }
+        {
+          std::unique_lock<std::mutex> lock(lock_);
+          waitingProducers_.fetch_add(1);
+          Fence::heavy();
+          while (!push(std::move(item)))
+            notFull_.wait(lock);
+          waitingProducers_.fetch_sub(1);
+        }
+        wake(waitingConsumers_, notEmpty_);
+      }
+
+      T dequeue()
+      {
+        T item;
+        dequeue(item);
+        return item;
+      }
+
+      void dequeue(T& item)
+      {
+        for (int i = 0; i < SpinCount; i++) {
+          if (tryDequeue(item))
+            return;
+          std::this_thread::yield();
+        }
+        {
+          std::unique_lock<std::mutex> lock(lock_);
+          waitingConsumers_.fetch_add(1);
+          Fence::heavy();
+          while (!pop(item))
+            notEmpty_.wait(lock);
+          waitingConsumers_.fetch_sub(1);
+        }
+        wake(waitingProducers_, notFull_);
+      }
+
+      size_t count() const
+      {
+        size_t first = dequeuePos_.load(std::memory_order_acquire);
+        size_t last = enqueuePos_.load(std::memory_order_acquire);
+        return last > first ? last - first : 0;
+      }
+
+      size_t size() const
+      {
+        return size_;
+      }
+
+      ~MpmcQueue()
+      {
+        size_t last = enqueuePos_.load(std::memory_order_acquire);
+        for (size_t pos = dequeuePos_.load(std::memory_order_acquire); pos != last; pos++)
+          reinterpret_cast<T*>(cells_[pos & (size_ - 1)].item)->~T();
+        for (size_t i = 0; i < size_; i++)
+          cells_[i].sequence.~atomic<size_t>();
+        free(cells_);
+      }
+
+    private:
+      static constexpr int SpinCount = 16;
+
+      struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char item[sizeof(T)];
+      };
+
+      Cell* cells_;
+      size_t size_;
+      alignas(SZ_CACHE_LINE) std::atomic<size_t> enqueuePos_;
+      alignas(SZ_CACHE_LINE) std::atomic<size_t> dequeuePos_;
+      alignas(SZ_CACHE_LINE) std::atomic<int> waitingProducers_;
+      std::atomic<int> waitingConsumers_;
+      std::mutex lock_;
+      std::condition_variable notFull_;
+      std::condition_variable notEmpty_;
+
+      //only moves out of item once a cell is claimed, so a failed push leaves it intact
+      bool push(T&& item)
+      {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+          cell = &cells_[pos & (size_ - 1)];
+          size_t sequence = cell->sequence.load(std::memory_order_acquire);
+          intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+          if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+          } else if (diff < 0) {
+            return false;
+          } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+          }
+        }
+        new (cell->item)T(std::move(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+
+      bool pop(T& item)
+      {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+          cell = &cells_[pos & (size_ - 1)];
+          size_t sequence = cell->sequence.load(std::memory_order_acquire);
+          intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+          if (diff == 0) {
+            if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+          } else if (diff < 0) {
+            return false;
+          } else {
+            pos = dequeuePos_.load(std::memory_order_relaxed);
+          }
+        }
+        T* value = reinterpret_cast<T*>(cell->item);
+        item = std::move(*value);
+        value->~T();
+        cell->sequence.store(pos + size_, std::memory_order_release);
+        return true;
+      }
+
+      void wake(std::atomic<int>& waiting, std::condition_variable& condition)
+      {
+        //pairs with the waiter's heavy fence so either it sees our update or we see it waiting
+        Fence::light();
+        if (waiting.load(std::memory_order_relaxed) == 0)
+          return;
+        std::lock_guard<std::mutex> lock(lock_);
+        condition.notify_all();
+      }
+  };
+}
+
+#endif
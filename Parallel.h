@@ -0,0 +1,332 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Parallel_h
+#define __Base_Parallel_h
+
+#include "Base/List.h"
+#include "Base/Relocatable.h"
+#include "Base/Sort.h"
+#include "Base/ThreadPool.h"
+#include "Base/compat/sizes.h"
+#include <algorithm>
+#include <new>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+namespace Base
+{
+  // Items per chunk when splitting count items of T across pool: about
+  // eight chunks per worker so stolen work balances out, but no less than
+  // 16K of items so a chunk outweighs the cost of a task, and a whole
+  // number of cache lines so neighbouring chunks never share one.
+  template <typename T>
+  size_t parallelGrain(size_t count, ThreadPool& pool)
+  {
+    size_t perLine = sizeof(T) < SZ_CACHE_LINE ? SZ_CACHE_LINE / sizeof(T) : 1;
+    size_t grain = count / (pool.threadCount() * 8) + 1;
+    grain = std::max<size_t>(grain, SZ_16K / sizeof(T) + 1);
+    return (grain + perLine - 1) / perLine * perLine;
+  }
+
+  template <typename F>
+  class ParallelChunkTask : public ThreadPool::Task {
+    public:
+      ParallelChunkTask(ThreadPool::Group& group, F const& function,
+                        size_t count, size_t grain, size_t first, size_t last) :
+        group_(group),
+        function_(function),
+        count_(count),
+        grain_(grain),
+        first_(first),
+        last_(last)
+      {}
+
+      // Hands the upper half of the chunks to the pool until one is left,
+      // so thieves take large pieces and the owner keeps the small ones
+      void run() override
+      {
+        while (last_ - first_ > 1) {
+          size_t mid = first_ + (last_ - first_) / 2;
+          group_.spawn(new ParallelChunkTask<F>(group_, function_, count_, grain_, mid, last_));
+          last_ = mid;
+        }
+        size_t begin = first_ * grain_;
+        function_(first_, begin, std::min(begin + grain_, count_));
+      }
+
+    private:
+      ThreadPool::Group& group_;
+      F const& function_;
+      size_t count_;
+      size_t grain_;
+      size_t first_;
+      size_t last_;
+  };
+
+  // Calls function(chunk, begin, end) on the pool for consecutive chunks
+  // of grain indexes covering [0, count), and returns once all are done.
+  // Rethrows the first exception thrown by function.
+  template <typename F>
+  void parallelChunks(size_t count, size_t grain, F const& function,
+                      ThreadPool& pool = ThreadPool::shared())
+  {
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks <= 1) {
+      if (count > 0)
+        function(0, 0, count);
+      return;
+    }
+    ThreadPool::Group group(pool);
+    group.spawn(new ParallelChunkTask<F>(group, function, count, grain, 0, chunks));
+    group.wait();
+  }
+
+  // Calls function(item) for every item, from several threads at once
+  template <typename T, typename F>
+  void parallelFor(List<T>& list, F function, ThreadPool& pool = ThreadPool::shared())
+  {
+    if (list.count() == 0)
+      return;
+    T* items = &list[0];
+    parallelChunks(list.count(), parallelGrain<T>(list.count(), pool),
+      [items, &function](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          function(items[i]);
+      }, pool);
+  }
+
+  // Returns the list of function(item) for every item, built in parallel
+  // straight into place
+  template <typename T, typename F,
+            typename R = typename std::decay<decltype(std::declval<F&>()(std::declval<T const&>()))>::type>
+  List<R> parallelMap(List<T> const& list, F function, ThreadPool& pool = ThreadPool::shared())
+  {
+    size_t count = list.count();
+    List<R> ret(count);
+    if (count == 0)
+      return ret;
+    T const* items = &list[0];
+    ret.addInPlace(count, [&](R* out, size_t) {
+      size_t grain = std::max(parallelGrain<T>(count, pool), parallelGrain<R>(count, pool));
+      size_t chunks = (count + grain - 1) / grain;
+      // Chunks that finished, so a failure can destroy exactly those
+      List<bool> built(chunks);
+      for (size_t i = 0; i < chunks; i++)
+        built.add(false);
+      try {
+        parallelChunks(count, grain, [&](size_t chunk, size_t begin, size_t end) {
+          size_t i = begin;
+          try {
+            for (; i < end; i++)
+              new (&out[i])R(function(items[i]));
+          } catch (...) {
+            while (i-- > begin)
+              out[i].~R();
+            throw;
+          }
+          built[chunk] = true;
+        }, pool);
+      } catch (...) {
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+          if (!built[chunk])
+            continue;
+          for (size_t i = chunk * grain; i < std::min((chunk + 1) * grain, count); i++)
+            out[i].~R();
+        }
+        throw;
+      }
+    });
+    return ret;
+  }
+
+  // Folds each chunk of the list from a copy of identity with
+  // fold(accumulator, item), then combines the chunk results in order with
+  // combine(accumulator, chunkResult). Both must be associative, with
+  // identity as their identity; the result does not depend on scheduling.
+  template <typename T, typename R, typename F, typename C>
+  R parallelReduce(List<T> const& list, R identity, F fold, C combine,
+                   ThreadPool& pool = ThreadPool::shared())
+  {
+    size_t count = list.count();
+    if (count == 0)
+      return identity;
+    T const* items = &list[0];
+    size_t grain = parallelGrain<T>(count, pool);
+    size_t chunks = (count + grain - 1) / grain;
+    List<R> partials(chunks);
+    for (size_t i = 0; i < chunks; i++)
+      partials.add(identity);
+    parallelChunks(count, grain, [&](size_t chunk, size_t begin, size_t end) {
+      R accumulator(identity);
+      for (size_t i = begin; i < end; i++)
+        accumulator = fold(std::move(accumulator), items[i]);
+      partials[chunk] = std::move(accumulator);
+    }, pool);
+    R ret(std::move(identity));
+    for (size_t i = 0; i < chunks; i++)
+      ret = combine(std::move(ret), partials[i]);
+    return ret;
+  }
+
+  namespace SortImpl
+  {
+    // Lists shorter than this sort faster on one thread
+    static const size_t ParallelThreshold = 1 << 16;
+
+    // Number of items from a in the first out items of the stable merge of
+    // a and b ("merge path")
+    template <typename T, typename C>
+    size_t coRank(size_t out, T const* a, size_t aCount, T const* b, size_t bCount,
+                  C& compare)
+    {
+      size_t lo = out > bCount ? out - bCount : 0;
+      size_t hi = std::min(out, aCount);
+      while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = out - i;
+        // a[i] is no greater than b[j - 1], so it belongs in the prefix
+        if (j > 0 && i < aCount && !compare(b[j - 1], a[i]))
+          lo = i + 1;
+        else
+          hi = i;
+      }
+      return lo;
+    }
+
+    // Sorts the list in chunks on the pool with sortChunk(items, count),
+    // then merges pairs of runs until one is left. Each round of merges is
+    // cut into pieces of equal output so the last, largest merges still
+    // use every thread. Items move between the list and the scratch
+    // buffer as bytes, so T must be Relocatable.
+    template <typename T, typename C, typename S>
+    void parallelMergeSort(List<T>& list, C& compare, S sortChunk, ThreadPool& pool)
+    {
+      size_t count = list.count();
+      T* items = &list[0];
+      size_t threads = pool.threadCount();
+      size_t runs = 1;
+      while (runs < threads * 2 && count / (runs * 2) >= ParallelThreshold / 4)
+        runs *= 2;
+      size_t width = (count + runs - 1) / runs;
+      parallelChunks(count, width, [&](size_t, size_t begin, size_t end) {
+        sortChunk(items + begin, end - begin);
+      }, pool);
+
+      T* scratch = (T*)allocate(nullptr, sizeof(T) * count);
+      T* from = items;
+      T* to = scratch;
+      for (; width < count; width *= 2) {
+        size_t pairs = (count + 2 * width - 1) / (2 * width);
+        size_t pieces = std::max<size_t>(1, threads * 4 / pairs);
+        parallelChunks(pairs * pieces, 1, [&](size_t task, size_t, size_t) {
+          size_t begin = task / pieces * 2 * width;
+          size_t piece = task % pieces;
+          T const* a = from + begin;
+          size_t aCount = std::min(width, count - begin);
+          T const* b = a + aCount;
+          size_t bCount = std::min(width, count - begin - aCount);
+          size_t total = aCount + bCount;
+          size_t outBegin = total * piece / pieces;
+          size_t outEnd = total * (piece + 1) / pieces;
+          size_t i = coRank(outBegin, a, aCount, b, bCount, compare);
+          size_t j = outBegin - i;
+          size_t iEnd = coRank(outEnd, a, aCount, b, bCount, compare);
+          size_t jEnd = outEnd - iEnd;
+          T* out = to + begin + outBegin;
+          while (i < iEnd && j < jEnd) {
+            if (compare(b[j], a[i]))
+              memcpy((void*)out++, (void const*)&b[j++], sizeof(T));
+            else
+              memcpy((void*)out++, (void const*)&a[i++], sizeof(T));
+          }
+          memcpy((void*)out, (void const*)&a[i], sizeof(T) * (iEnd - i));
+          out += iEnd - i;
+          memcpy((void*)out, (void const*)&b[j], sizeof(T) * (jEnd - j));
+        }, pool);
+        std::swap(from, to);
+      }
+      if (from != items) {
+        parallelChunks(count, parallelGrain<T>(count, pool), [&](size_t, size_t begin, size_t end) {
+          memcpy((void*)(items + begin), (void const*)(from + begin), sizeof(T) * (end - begin));
+        }, pool);
+      }
+      release(nullptr, scratch, sizeof(T) * count);
+    }
+  }
+
+  // Sorts the list, not stably, using the whole pool once it is large
+  // enough to gain from it: chunks are sorted as List::sort would, then
+  // merged in parallel. Types that are not Relocatable, and short lists,
+  // are sorted on the calling thread. compare must not throw.
+  template <typename T, typename C>
+  void parallelSort(List<T>& list, C compare, ThreadPool& pool = ThreadPool::shared())
+  {
+    if (!Relocatable<T>::value || list.count() < SortImpl::ParallelThreshold ||
+        pool.threadCount() < 2) {
+      list.sort(compare);
+      return;
+    }
+    SortImpl::parallelMergeSort(list, compare, [&compare](T* items, size_t count) {
+      sortRange(items, count, compare);
+    }, pool);
+  }
+
+  template <typename T>
+  void parallelSort(List<T>& list, ThreadPool& pool = ThreadPool::shared())
+  {
+    if (!Relocatable<T>::value || list.count() < SortImpl::ParallelThreshold ||
+        pool.threadCount() < 2) {
+      list.sort();
+      return;
+    }
+    Less<T> compare;
+    SortImpl::parallelMergeSort(list, compare, [](T* items, size_t count) {
+      DefaultSort<T>::sort(items, count);
+    }, pool);
+  }
+
+  // As parallelSort, keeping equal items in their original order
+  template <typename T, typename C>
+  void parallelStableSort(List<T>& list, C compare, ThreadPool& pool = ThreadPool::shared())
+  {
+    if (!Relocatable<T>::value || list.count() < SortImpl::ParallelThreshold ||
+        pool.threadCount() < 2) {
+      list.stableSort(compare);
+      return;
+    }
+    SortImpl::parallelMergeSort(list, compare, [&compare](T* items, size_t count) {
+      stableSortRange(items, count, compare);
+    }, pool);
+  }
+
+  template <typename T>
+  void parallelStableSort(List<T>& list, ThreadPool& pool = ThreadPool::shared())
+  {
+    if (!Relocatable<T>::value || list.count() < SortImpl::ParallelThreshold ||
+        pool.threadCount() < 2) {
+      list.stableSort();
+      return;
+    }
+    Less<T> compare;
+    SortImpl::parallelMergeSort(list, compare, [](T* items, size_t count) {
+      DefaultSort<T>::stableSort(items, count);
+    }, pool);
+  }
+}
+
+#endif
@@ -18,6 +18,7 @@
 #define __Base_Queue_h
 
 #include "Base/List.h"
+#include "Base/Stats.h"
 #include <algorithm>
 
 //TODO: this has only been converted from lists in the constructor!
@@ -26,88 +27,129 @@ namespace Base
   template <typename T>
   class Queue {
     public:
-      Queue(T const* items, size_t count, size_t containerSize = 0) :
+      Queue(T const* items, size_t count, size_t containerSize = 0,
+            Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(count),
         size_(std::max(count, containerSize)),
-        first_(0)
+        first_(0),
+        alloc_(alloc)
       {
         assert(items != nullptr);
-        items_ = (T*)malloc(sizeof(T) * size_);
-        if (items_ == nullptr)
-          throw std::bad_alloc();
-        for (off_t i = 0; i < count; ++i) {
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<Queue<T>>().allocated(sizeof(T) * size_);
+        Stats::of<Queue<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count; ++i) {
           try {
             new (&items_[i])T(items[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++)
-              items_[i].~T();
-            free(items_);
+              items_[j].~T();
+            release(alloc_, items_, sizeof(T) * size_);
             throw;
           }
         }
       }
 
-      Queue(size_t containerSize = 0) :
+      Queue(size_t containerSize = 0, Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(0),
         size_(containerSize),
-        first_(0)
+        first_(0),
+        alloc_(alloc)
       {
         if (size_ > 0) {
-          items_ = (T*)malloc(sizeof(T) * size_);
-          if (items_ == nullptr)
-            throw std::bad_alloc();
+          items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+          Stats::of<Queue<T>>().allocated(sizeof(T) * size_);
         }
       }
 
-      Queue(Queue<T> const& value) :
+      Queue(Queue<T> const& value, Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(value.count_),
         size_(value.size_),
-        first_(value.first_)
+        first_(0),
+        alloc_(alloc)
       {
-        items_ = (T*)malloc(sizeof(T) * size_);
-        if (items_ == nullptr)
-          throw std::bad_alloc();
-        for (off_t i = 0; i < count; ++i) {
+        if (size_ == 0)
+          return;
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<Queue<T>>().allocated(sizeof(T) * size_);
+        Stats::of<Queue<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count_; ++i) {
           try {
             new (&items_[i])T(value[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++)
-              items_[i].~T();
-            free(items_);
+              items_[j].~T();
+            release(alloc_, items_, sizeof(T) * size_);
             throw;
           }
         }
       }
 
-      Queue(List<T> const& value) :
+      Queue(Queue<T>&& value) noexcept :
+        items_(value.items_),
+        count_(value.count_),
+        size_(value.size_),
+        first_(value.first_),
+        alloc_(value.alloc_)
+      {
+        value.items_ = nullptr;
+        value.count_ = 0;
+        value.size_ = 0;
+        value.first_ = 0;
+      }
+
+      Queue(List<T> const& value, Allocator* alloc = nullptr) :
         items_(nullptr),
-        count_(value.getCount()),
-        size_(value.getSize()),
-        first_(0)
+        count_(value.count()),
+        size_(value.size()),
+        first_(0),
+        alloc_(alloc)
       {
-        items_ = (T*)malloc(sizeof(T) * size_);
-        if (items_ == nullptr)
-          throw std::bad_alloc();
-        for (off_t i = 0; i < count; ++i) {
+        if (size_ == 0)
+          return;
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<Queue<T>>().allocated(sizeof(T) * size_);
+        Stats::of<Queue<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count_; ++i) {
           try {
             new (&items_[i])T(value[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++)
-              items_[i].~T();
-            free(items_);
+              items_[j].~T();
+            release(alloc_, items_, sizeof(T) * size_);
             throw;
           }
         }
       }
 
+      Queue<T>& operator= (Queue<T>&& value) noexcept
+      {
+        if (&value == this)
+          return *this;
+        for (off_t i = 0; i < (ssize_t)count_; i++)
+          (*this)[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
+        items_ = value.items_;
+        count_ = value.count_;
+        size_ = value.size_;
+        first_ = value.first_;
+        alloc_ = value.alloc_;
+        value.items_ = nullptr;
+        value.count_ = 0;
+        value.size_ = 0;
+        value.first_ = 0;
+        return *this;
+      }
+
       Queue<T>& operator= (Queue<T> const& value)
       {
         off_t i;
 
         minSize(value.count_);
+        Stats::of<Queue<T>>().copied(value.count_);
         for (i = 0; i < (ssize_t)count_ && i < (ssize_t)value.count_; ++i) {
           off_t ind = (first_ + i) % size_;
           items_[ind] = value[i];
@@ -133,28 +175,40 @@ namespace Base
       }
 
       void enqueue(T const& item)
+      {
+        emplace(item);
+      }
+
+      void enqueue(T&& item)
+      {
+        emplace(std::move(item));
+      }
+
+      template <typename... Args>
+      T& emplace(Args&&... args)
       {
         minSize(count_ + 1);
         off_t pos = first_ + count_;
         if (pos >= (ssize_t)size_) pos -= size_;
-        new(&items_[pos])T(item);
+        new(&items_[pos])T(std::forward<Args>(args)...);
         count_++;
+        return items_[pos];
       }
 
       void enqueue(T const* items, size_t count = 1)
       {
         assert(items != nullptr);
         minSize(count_ + count);
-        for (off_t i = 0; i < count; ++i)
+        for (off_t i = 0; i < (ssize_t)count; ++i)
         {
           off_t pos = first_ + i + count_;
-          if (pos >= size_) pos -= size_;
+          if (pos >= (ssize_t)size_) pos -= size_;
           try {
             new(&items_[pos])T(items[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++) {
               pos = first_ + j + count_;
-              if (pos >= size_) pos -= size_;
+              if (pos >= (ssize_t)size_) pos -= size_;
               items_[pos].~T();
             }
             throw;
@@ -166,28 +220,28 @@ namespace Base
       void enqueue(List<T> const& items)
       {
         minSize(count_ + items.count());
-        for (off_t i = 0; i < items.count(); ++i)
+        for (off_t i = 0; i < (ssize_t)items.count(); ++i)
         {
           off_t pos = first_ + i + count_;
-          if (pos >= size_) pos -= size_;
+          if (pos >= (ssize_t)size_) pos -= size_;
           try {
             new(&items_[pos])T(items[i]);
           } catch (...) {
             for (off_t j = 0; j < i; j++) {
               pos = first_ + j + count_;
-              if (pos >= size_) pos -= size_;
+              if (pos >= (ssize_t)size_) pos -= size_;
               items_[pos].~T();
             }
             throw;
           }
         }
-        count_ += items.getCount();
+        count_ += items.count();
       }
 
       T dequeue()
       {
         assert(count_ > 0);
-        T val = items_[first_];
+        T val = std::move(items_[first_]);
         items_[first_].~T();
         first_ += 1;
         if (first_ >= (ssize_t)size_) first_ = 0;
@@ -205,15 +259,14 @@ namespace Base
       void dequeue(List<T>& list, size_t count)
       {
         assert(count <= count_);
-        size_t len = std::min(count, size_ - first_);
-        list.add(items_ + first_, len);
-        list.add(items_, count - len);
-        for (off_t i = 0; i < count; i++) {
+        list.size(std::max(list.size(), list.count() + count));
+        for (off_t i = 0; i < (ssize_t)count; i++) {
           off_t pos = (i + first_) % size_;
+          list.add(std::move(items_[pos]));
           items_[pos].~T();
         }
         first_ += count;
-        if (first_ >= size_) first_ -= size_;
+        if (first_ >= (ssize_t)size_) first_ -= size_;
         count_ -= count;
       }
 
@@ -231,22 +284,23 @@ namespace Base
       {
         assert(size >= count_);
         if (size_ == size) return;
-        T* newItems = (T*)malloc(sizeof(T) * size);
-        if (newItems == nullptr)
-          throw std::bad_alloc();
+        T* newItems = (T*)allocate(alloc_, sizeof(T) * size);
+        Stats::of<Queue<T>>().resized();
+        Stats::of<Queue<T>>().allocated(sizeof(T) * size);
+        Stats::of<Queue<T>>().copied(count_);
         for (off_t i = 0; i < (ssize_t)count_; ++i) {
           try {
-            new (&newItems[i])T((*this)[i]);
+            new (&newItems[i])T(std::move_if_noexcept((*this)[i]));
           } catch (...) {
             for (off_t j = 0; j < i; j++)
               newItems[j].~T();
-            free(newItems);
+            release(alloc_, newItems, sizeof(T) * size);
             throw;
           }
         }
         for (off_t i = 0; i < (ssize_t)count_; i++)
-          items_[i].~T();
-        free(items_);
+          (*this)[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
         items_ = newItems;
         size_ = size;
         first_ = 0;
@@ -286,11 +340,22 @@ namespace Base
         return *this;
       }
 
+      Queue<T>& operator+= (T&& value)
+      {
+        enqueue(std::move(value));
+        return *this;
+      }
+
+      Allocator* allocator() const
+      {
+        return alloc_;
+      }
+
       ~Queue()
       {
         for (off_t i = 0; i < (ssize_t)count_; i++)
-          items_[i].~T();
-        free(items_);
+          (*this)[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
       }
 
     private:
@@ -298,6 +363,7 @@ namespace Base
       size_t count_;
       size_t size_;
       off_t first_;
+      Allocator* alloc_;
 
       void minSize(uint64_t size)
       {
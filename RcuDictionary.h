@@ -0,0 +1,344 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_RcuDictionary_h
+#define __Base_RcuDictionary_h
+
+#include "Base/Epoch.h"
+#include "Base/Hash.h"
+#include "Base/List.h"
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+namespace Base {
+  template <typename T_Key, typename T_Value>
+  class RcuDictionaryIter;
+
+  // Chained dictionary for read-mostly data such as configuration and
+  // routing tables. Readers take no lock and write no shared memory: they
+  // follow atomically published pointers under an Epoch::Guard. Writers
+  // are serialized by a mutex and never modify a published node; they link
+  // in new nodes, copy the part of a chain in front of a node they remove
+  // or replace, and publish a whole new table when growing. Unlinked
+  // memory is reclaimed through Epoch once no reader can still see it.
+  //
+  // The API follows Dictionary, except where a reference into a node would
+  // outlive it or a check-then-act would race another writer: operator[]
+  // and tryGet copy the value out, add returns false rather than asserting
+  // when the key is present, and values are changed with set.
+  template <typename T_Key, typename T_Value>
+  class RcuDictionary {
+  public:
+  class KVP {
+    public:
+      T_Key const& key;
+      T_Value const& value;
+
+      KVP(T_Key const& key, T_Value const& value) :
+        key(key),
+        value(value)
+      {}
+  };
+
+    RcuDictionary(size_t size = 4) :
+      table_(nullptr),
+      count_(0)
+    {
+      assert(size > 0);
+      table_.store(new Table(size), std::memory_order_release);
+    }
+
+    RcuDictionary(RcuDictionary<T_Key, T_Value> const&) = delete;
+    RcuDictionary<T_Key, T_Value>& operator= (RcuDictionary<T_Key, T_Value> const&) = delete;
+
+    // Returns false (and leaves the entry alone) when the key is present
+    bool add(T_Key const& key, T_Value const& value)
+    {
+      std::lock_guard<std::mutex> guard(writeLock_);
+      if (find(table_.load(std::memory_order_relaxed), key) != nullptr)
+        return false;
+      insert(new Node{nullptr, key, value});
+      return true;
+    }
+
+    bool add(T_Key&& key, T_Value&& value)
+    {
+      std::lock_guard<std::mutex> guard(writeLock_);
+      if (find(table_.load(std::memory_order_relaxed), key) != nullptr)
+        return false;
+      insert(new Node{nullptr, std::move(key), std::move(value)});
+      return true;
+    }
+
+    // Adds the entry, or replaces the value of an existing one. Returns
+    // true when the key was added.
+    bool set(T_Key const& key, T_Value const& value)
+    {
+      std::lock_guard<std::mutex> guard(writeLock_);
+      Node* node = new Node{nullptr, key, value};
+      if (unlink(key, node))
+        return false;
+      insert(node);
+      return true;
+    }
+
+    // Returns false when the key was not present
+    bool remove(T_Key const& key)
+    {
+      std::lock_guard<std::mutex> guard(writeLock_);
+      if (!unlink(key, nullptr))
+        return false;
+      count_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    bool containsKey(T_Key const& key) const
+    {
+      Epoch::Guard guard;
+      return find(table_.load(std::memory_order_acquire), key) != nullptr;
+    }
+
+    // Copies the value into value and returns true when the key is present
+    bool tryGet(T_Key const& key, T_Value& value) const
+    {
+      Epoch::Guard guard;
+      Node* node = find(table_.load(std::memory_order_acquire), key);
+      if (node == nullptr)
+        return false;
+      value = node->value;
+      return true;
+    }
+
+    size_t count() const {
+      return count_.load(std::memory_order_relaxed);
+    }
+
+    Base::List<T_Key> keys() const {
+      Base::List<T_Key> keys_ret(count());
+      for (auto it = iter(); it.valid(); it.next())
+        keys_ret.add(it.value().key);
+      return keys_ret;
+    }
+
+    T_Value operator[] (T_Key const& key) const
+    {
+      Epoch::Guard guard;
+      Node* node = find(table_.load(std::memory_order_acquire), key);
+      assert(node != nullptr);
+      return node->value;
+    }
+
+    RcuDictionaryIter<T_Key, T_Value> iter() const {
+      return RcuDictionaryIter<T_Key, T_Value>(*this);
+    }
+
+    // No reader may be using the dictionary
+    ~RcuDictionary()
+    {
+      delete table_.load(std::memory_order_relaxed);
+      Epoch::collect();
+    }
+
+  private:
+    struct Node {
+      Node* next;
+      T_Key key;
+      T_Value value;
+    };
+
+    // Owns its nodes; after a grow the old table is retired with the
+    // chains it held, which by then are unreachable from the new one
+    struct Table {
+      size_t size;
+      std::atomic<Node*>* buckets;
+
+      Table(size_t size) :
+        size(size),
+        buckets(new std::atomic<Node*>[size])
+      {
+        for (off_t i = 0; i < (ssize_t)size; i++)
+          buckets[i].store(nullptr, std::memory_order_relaxed);
+      }
+
+      ~Table()
+      {
+        for (off_t i = 0; i < (ssize_t)size; i++) {
+          Node* node = buckets[i].load(std::memory_order_relaxed);
+          while (node != nullptr) {
+            Node* next = node->next;
+            delete node;
+            node = next;
+          }
+        }
+        delete[] buckets;
+      }
+
+      std::atomic<Node*>& bucket(T_Key const& key) const
+      {
+        return buckets[hash<T_Key>(key) % size];
+      }
+    };
+
+    std::atomic<Table*> table_;
+    std::atomic<size_t> count_;
+    std::mutex writeLock_;
+
+    friend class RcuDictionaryIter<T_Key, T_Value>;
+
+    static Node* find(Table* table, T_Key const& key)
+    {
+      Node* node = table->bucket(key).load(std::memory_order_acquire);
+      while (node != nullptr) {
+        if (node->key == key)
+          return node;
+        node = node->next;
+      }
+      return nullptr;
+    }
+
+    // Links a node for a key known to be absent, growing first if needed
+    void insert(Node* node)
+    {
+      size_t count = count_.load(std::memory_order_relaxed);
+      Table* table = table_.load(std::memory_order_relaxed);
+      if (count >= table->size)
+        table = grow(std::max<size_t>(count * 2, 4));
+      std::atomic<Node*>& bucket = table->bucket(node->key);
+      node->next = bucket.load(std::memory_order_relaxed);
+      bucket.store(node, std::memory_order_release);
+      count_.store(count + 1, std::memory_order_relaxed);
+    }
+
+    // Takes the node for key out of its chain, putting replacement (if
+    // any) in its place. The nodes in front of it are copied, since
+    // readers may be walking the originals. Returns false if absent.
+    bool unlink(T_Key const& key, Node* replacement)
+    {
+      std::atomic<Node*>& bucket = table_.load(std::memory_order_relaxed)->bucket(key);
+      Node* head = bucket.load(std::memory_order_relaxed);
+      Node* target = head;
+      size_t before = 0;
+      while (target != nullptr && !(target->key == key)) {
+        target = target->next;
+        before++;
+      }
+      if (target == nullptr)
+        return false;
+
+      Node* rest = target->next;
+      if (replacement != nullptr) {
+        replacement->next = rest;
+        rest = replacement;
+      }
+      if (before == 0) {
+        bucket.store(rest, std::memory_order_release);
+        Epoch::retire(target);
+        return true;
+      }
+      List<Node*> unlinked(before + 1);
+      for (Node* node = head; node != target; node = node->next)
+        unlinked.add(node);
+      for (off_t i = (ssize_t)before - 1; i >= 0; i--)
+        rest = new Node{rest, unlinked[i]->key, unlinked[i]->value};
+      bucket.store(rest, std::memory_order_release);
+
+      // One batch, since each retire costs a heavy fence
+      unlinked.add(target);
+      Epoch::retire(&unlinked[0], unlinked.count());
+      return true;
+    }
+
+    Table* grow(size_t size)
+    {
+      Table* old = table_.load(std::memory_order_relaxed);
+      Table* table = new Table(size);
+      for (off_t i = 0; i < (ssize_t)old->size; i++) {
+        for (Node* node = old->buckets[i].load(std::memory_order_relaxed); node != nullptr; node = node->next) {
+          std::atomic<Node*>& bucket = table->bucket(node->key);
+          bucket.store(new Node{bucket.load(std::memory_order_relaxed), node->key, node->value},
+                       std::memory_order_relaxed);
+        }
+      }
+      table_.store(table, std::memory_order_release);
+      Epoch::retire(old);
+      return table;
+    }
+  };
+
+  // Walks the table that was current when the iterator was made, holding
+  // an Epoch::Guard so none of it is freed meanwhile. Entries present for
+  // the whole walk are seen once; concurrent changes may or may not be.
+  // Keep it on the thread that made it, and not for long, since it holds
+  // back reclamation.
+  template <typename T_Key, typename T_Value>
+  class RcuDictionaryIter {
+    public:
+      RcuDictionaryIter(RcuDictionary<T_Key, T_Value> const& dict) :
+        table_(dict.table_.load(std::memory_order_acquire)),
+        index_(0),
+        node_(nullptr)
+      {
+        findNext();
+      }
+
+      void next()
+      {
+        if (node_ == nullptr)
+          return;
+        node_ = node_->next;
+        if (node_ == nullptr) {
+          index_++;
+          findNext();
+        }
+      }
+
+      bool valid() const {
+        return node_ != nullptr;
+      }
+
+      typename RcuDictionary<T_Key, T_Value>::KVP value() const
+      {
+        assert(node_ != nullptr);
+        return typename RcuDictionary<T_Key, T_Value>::KVP(
+          node_->key,
+          node_->value);
+      }
+
+    private:
+      typedef typename RcuDictionary<T_Key, T_Value>::Table Table;
+      typedef typename RcuDictionary<T_Key, T_Value>::Node Node;
+
+      // Declared first so it is entered before the table is loaded
+      Epoch::Guard guard_;
+      Table* table_;
+      size_t index_;
+      Node* node_;
+
+      void findNext()
+      {
+        for (; index_ < table_->size; index_++) {
+          node_ = table_->buckets[index_].load(std::memory_order_acquire);
+          if (node_ != nullptr)
+            return;
+        }
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,35 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Relocatable_h
+#define __Base_Relocatable_h
+
+#include <type_traits>
+
+namespace Base
+{
+  // True when a T can be moved to a new address by copying its bytes and
+  // forgetting the original, without running its move constructor or
+  // destructor. Containers use this to grow with realloc and to shift
+  // elements with memmove. Trivially copyable types qualify automatically;
+  // other types opt in by specializing this next to their definition. Only
+  // do so for types that hold no pointers into themselves.
+  template <typename T>
+  struct Relocatable : std::integral_constant<bool,
+    std::is_trivially_copyable<T>::value> {};
+}
+
+#endif
@@ -0,0 +1,458 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_RobinHoodDictionary_h
+#define __Base_RobinHoodDictionary_h
+
+#include "Base/Hash.h"
+#include "Base/List.h"
+#include "Base/Stats.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <utility>
+
+namespace Base {
+  template <typename T_Key, typename T_Value>
+  class RobinHoodDictionaryIter;
+
+  // Open addressing table with linear probing and Robin Hood placement,
+  // with the same interface as Dictionary. Keys and values are stored
+  // inline, with a separate byte per bucket holding its probe distance.
+  // Keys stay ordered by home bucket, which bounds probe lengths, lets a
+  // miss stop at the first poorer bucket and lets remove shift the rest of
+  // a run back instead of leaving tombstones. Suited to small keys such as
+  // integers; lookupBatch overlaps the cache misses of many lookups on
+  // tables larger than the cache.
+  template <typename T_Key, typename T_Value>
+  class RobinHoodDictionary {
+  public:
+  class KVP {
+    public:
+      T_Key const& key;
+      T_Value& value;
+
+      KVP(T_Key const& key, T_Value& value) :
+        key(key),
+        value(value)
+      {}
+  };
+
+    RobinHoodDictionary(size_t size = 4, Allocator* alloc = nullptr) :
+      count_(0),
+      capacity_(0),
+      shift_(64),
+      distances_(nullptr),
+      slots_(nullptr),
+      alloc_(alloc)
+    {
+      allocate(capacityFor(size));
+    }
+
+    RobinHoodDictionary(RobinHoodDictionary<T_Key, T_Value> const& dict,
+                        Allocator* alloc = nullptr) :
+      count_(0),
+      capacity_(0),
+      shift_(64),
+      distances_(nullptr),
+      slots_(nullptr),
+      alloc_(alloc)
+    {
+      allocate(capacityFor(dict.count_));
+      try {
+        for (auto it = dict.iter(); it.valid(); it.next())
+          add(it.value().key, it.value().value);
+      } catch (...) {
+        destroy();
+        throw;
+      }
+    }
+
+    RobinHoodDictionary(RobinHoodDictionary<T_Key, T_Value>&& dict) noexcept :
+      count_(dict.count_),
+      capacity_(dict.capacity_),
+      shift_(dict.shift_),
+      distances_(dict.distances_),
+      slots_(dict.slots_),
+      alloc_(dict.alloc_)
+    {
+      dict.count_ = 0;
+      dict.capacity_ = 0;
+      dict.shift_ = 64;
+      dict.distances_ = nullptr;
+      dict.slots_ = nullptr;
+    }
+
+    RobinHoodDictionary<T_Key, T_Value>& operator= (RobinHoodDictionary<T_Key, T_Value> const& dict)
+    {
+      if (&dict == this)
+        return *this;
+      Allocator* alloc = alloc_;
+      this->~RobinHoodDictionary<T_Key, T_Value>();
+      new(this)RobinHoodDictionary<T_Key, T_Value>(dict, alloc);
+      return *this;
+    }
+
+    RobinHoodDictionary<T_Key, T_Value>& operator= (RobinHoodDictionary<T_Key, T_Value>&& dict) noexcept
+    {
+      if (&dict == this)
+        return *this;
+      this->~RobinHoodDictionary<T_Key, T_Value>();
+      new(this)RobinHoodDictionary<T_Key, T_Value>(std::move(dict));
+      return *this;
+    }
+
+    void add(T_Key const& key, T_Value const& value)
+    {
+      emplace(key, value);
+    }
+
+    void add(T_Key&& key, T_Value&& value)
+    {
+      emplace(std::move(key), std::move(value));
+    }
+
+    template <typename K, typename... Args>
+    T_Value& emplace(K&& key, Args&&... args)
+    {
+      assert(!containsKey(key));
+      if (count_ >= maxLoad(capacity_))
+        resize(capacity_ == 0 ? MinCapacity : capacity_ * 2);
+      size_t hashValue = hashOf(key);
+      size_t index;
+      uint8_t distance;
+      // A long probe means clustering, so grow rather than let lookups
+      // degrade; below a quarter full the hash is at fault and growing
+      // would not help
+      while (!place(hashValue, count_ * 4 < capacity_ ? UINT8_MAX : MaxProbe,
+                    index, distance))
+        resize(capacity_ * 2);
+      try {
+        new (&slots_[index])Slot{
+          T_Key(std::forward<K>(key)),
+          T_Value(std::forward<Args>(args)...)
+        };
+      } catch (...) {
+        closeGap(index);
+        throw;
+      }
+      distances_[index] = distance;
+      count_ += 1;
+      Stats::of<RobinHoodDictionary<T_Key, T_Value>>().loaded(count_, capacity_);
+      return slots_[index].value;
+    }
+
+    // Removes key's entry, if any; true when there was one
+    bool remove(T_Key const& key)
+    {
+      off_t index = find(key);
+      if (index < 0)
+        return false;
+      slots_[index].~Slot();
+      closeGap(index);
+      count_ -= 1;
+      return true;
+    }
+
+    bool containsKey(T_Key const& key) const
+    {
+      return find(key) >= 0;
+    }
+
+    size_t count() const {
+      return count_;
+    }
+
+    Base::List<T_Key> keys() const {
+      Base::List<T_Key> keys_ret(count());
+      for (off_t i = 0; i < (ssize_t)capacity_; i++) {
+        if (distances_[i] != 0)
+          keys_ret.add(slots_[i].key);
+      }
+      return keys_ret;
+    }
+
+    T_Value& operator[] (T_Key const& key) const
+    {
+      off_t index = find(key);
+      assert(index >= 0);
+      return slots_[index].value;
+    }
+
+    // Sets out[i] to the value for keys[i], or nullptr when it is absent.
+    // Home buckets are prefetched a few keys ahead of the one being probed,
+    // so the batch waits on several cache misses at once rather than one
+    // after another.
+    void lookupBatch(T_Key const* keys, size_t n, T_Value** out) const
+    {
+      if (capacity_ == 0) {
+        for (size_t i = 0; i < n; i++)
+          out[i] = nullptr;
+        return;
+      }
+      size_t homes[PrefetchAhead];
+      for (size_t i = 0; i < n && i < PrefetchAhead; i++) {
+        homes[i] = home(hashOf(keys[i]));
+        prefetch(homes[i]);
+      }
+      for (size_t i = 0; i < n; i++) {
+        size_t index = homes[i % PrefetchAhead];
+        if (i + PrefetchAhead < n) {
+          size_t ahead = home(hashOf(keys[i + PrefetchAhead]));
+          prefetch(ahead);
+          homes[i % PrefetchAhead] = ahead;
+        }
+        off_t found = probe(index, keys[i]);
+        out[i] = found < 0 ? nullptr : &slots_[found].value;
+      }
+    }
+
+    RobinHoodDictionaryIter<T_Key, T_Value> iter() const {
+      return RobinHoodDictionaryIter<T_Key, T_Value>(*this);
+    }
+
+    Allocator* allocator() const {
+      return alloc_;
+    }
+
+    ~RobinHoodDictionary()
+    {
+      destroy();
+    }
+
+  private:
+    static constexpr size_t MinCapacity = 8;
+    // Longest probe an insert accepts before growing the table. Random
+    // keys reach about 50 at the highest load on 16M buckets.
+    static constexpr uint8_t MaxProbe = 128;
+    static constexpr size_t PrefetchAhead = 16;
+
+    struct Slot {
+      T_Key key;
+      T_Value value;
+    };
+
+    size_t count_;
+    size_t capacity_;
+    unsigned shift_;
+    // Per bucket: 0 when empty, otherwise 1 + the distance from the key's
+    // home bucket. Kept apart from the slots so probing stays in cache.
+    uint8_t* distances_;
+    Slot* slots_;
+    Allocator* alloc_;
+
+    friend class RobinHoodDictionaryIter<T_Key, T_Value>;
+
+    static size_t hashOf(T_Key const& key)
+    {
+      return (size_t)hash<T_Key>(key);
+    }
+
+    static size_t maxLoad(size_t capacity)
+    {
+      return capacity - capacity / 8;
+    }
+
+    static size_t capacityFor(size_t count)
+    {
+      size_t capacity = MinCapacity;
+      while (maxLoad(capacity) < count)
+        capacity *= 2;
+      return capacity;
+    }
+
+    // Hashes are fully mixed, so the top bits pick the home bucket. Only
+    // called once buckets exist, when shift_ is below 64.
+    size_t home(size_t hashValue) const
+    {
+      return hashValue >> shift_;
+    }
+
+    void prefetch(size_t index) const
+    {
+      __builtin_prefetch(&distances_[index]);
+      __builtin_prefetch(&slots_[index]);
+    }
+
+    off_t find(T_Key const& key) const
+    {
+      if (capacity_ == 0)
+        return -1;
+      size_t index = home(hashOf(key));
+      // Start on the slot while the distance loads, rather than after
+      __builtin_prefetch(&slots_[index]);
+      return probe(index, key);
+    }
+
+    off_t probe(size_t index, T_Key const& key) const
+    {
+      size_t mask = capacity_ - 1;
+      size_t probes = 0;
+      for (uint8_t distance = 1;; distance++) {
+        probes++;
+        // Keys are ordered by home, so a poorer bucket ends the search
+        if (distances_[index] < distance) {
+          Stats::of<RobinHoodDictionary<T_Key, T_Value>>().probed(probes);
+          return -1;
+        }
+        if (distances_[index] == distance && slots_[index].key == key) {
+          Stats::of<RobinHoodDictionary<T_Key, T_Value>>().probed(probes);
+          return index;
+        }
+        index = (index + 1) & mask;
+      }
+    }
+
+    // Opens the bucket a key with hashValue belongs in by shifting the
+    // run after it up one bucket, and returns it with the key's distance.
+    // Fails without changing anything if the key or a shifted one would
+    // end up further than maxDistance from home.
+    bool place(size_t hashValue, uint8_t maxDistance, size_t& index, uint8_t& distance)
+    {
+      size_t mask = capacity_ - 1;
+      index = home(hashValue);
+      distance = 1;
+      while (distances_[index] >= distance) {
+        if (distance == maxDistance)
+          return false;
+        index = (index + 1) & mask;
+        distance++;
+      }
+      size_t end = index;
+      for (; distances_[end] != 0; end = (end + 1) & mask) {
+        if (distances_[end] >= maxDistance)
+          return false;
+      }
+      while (end != index) {
+        size_t prev = (end - 1) & mask;
+        new (&slots_[end])Slot(std::move(slots_[prev]));
+        slots_[prev].~Slot();
+        distances_[end] = distances_[prev] + 1;
+        end = prev;
+      }
+      return true;
+    }
+
+    // Backward shift: pulls the rest of the run after an emptied bucket
+    // down one, so no tombstone is needed
+    void closeGap(size_t index)
+    {
+      size_t mask = capacity_ - 1;
+      size_t next = (index + 1) & mask;
+      while (distances_[next] > 1) {
+        new (&slots_[index])Slot(std::move(slots_[next]));
+        slots_[next].~Slot();
+        distances_[index] = distances_[next] - 1;
+        index = next;
+        next = (next + 1) & mask;
+      }
+      distances_[index] = 0;
+    }
+
+    void allocate(size_t capacity)
+    {
+      uint8_t* distances = (uint8_t*)Base::allocate(alloc_, capacity);
+      Slot* slots;
+      try {
+        slots = (Slot*)Base::allocate(alloc_, sizeof(Slot) * capacity);
+      } catch (...) {
+        release(alloc_, distances, capacity);
+        throw;
+      }
+      Stats::of<RobinHoodDictionary<T_Key, T_Value>>().allocated((1 + sizeof(Slot)) * capacity);
+      memset(distances, 0, capacity);
+      distances_ = distances;
+      slots_ = slots;
+      capacity_ = capacity;
+      shift_ = 64 - __builtin_ctzll(capacity);
+    }
+
+    void resize(size_t capacity)
+    {
+      Stats::of<RobinHoodDictionary<T_Key, T_Value>>().resized();
+      uint8_t* oldDistances = distances_;
+      Slot* oldSlots = slots_;
+      size_t oldCapacity = capacity_;
+      allocate(capacity);
+      for (size_t i = 0; i < oldCapacity; i++) {
+        if (oldDistances[i] == 0)
+          continue;
+        size_t index;
+        uint8_t distance;
+        // Doubling only spreads keys out, so this should not fail; if a
+        // hash manages it, grow again as emplace does
+        while (!place(hashOf(oldSlots[i].key), UINT8_MAX, index, distance))
+          resize(capacity_ * 2);
+        new (&slots_[index])Slot(std::move(oldSlots[i]));
+        distances_[index] = distance;
+        oldSlots[i].~Slot();
+      }
+      release(alloc_, oldDistances, oldCapacity);
+      release(alloc_, oldSlots, sizeof(Slot) * oldCapacity);
+    }
+
+    void destroy()
+    {
+      for (size_t i = 0; i < capacity_; i++) {
+        if (distances_[i] != 0)
+          slots_[i].~Slot();
+      }
+      release(alloc_, distances_, capacity_);
+      release(alloc_, slots_, sizeof(Slot) * capacity_);
+      distances_ = nullptr;
+      slots_ = nullptr;
+      capacity_ = 0;
+      shift_ = 64;
+      count_ = 0;
+    }
+  };
+
+  template <typename T_Key, typename T_Value>
+  class RobinHoodDictionaryIter {
+    public:
+      RobinHoodDictionaryIter(RobinHoodDictionary<T_Key, T_Value> const& dict) :
+        i_(-1),
+        dict_(&dict)
+      {
+        next();
+      }
+
+      void next()
+      {
+        for (i_++; i_ < (ssize_t)dict_->capacity_; i_++) {
+          if (dict_->distances_[i_] != 0)
+            return;
+        }
+      }
+
+      bool valid() const {
+        return i_ < (ssize_t)dict_->capacity_;
+      }
+
+      typename RobinHoodDictionary<T_Key, T_Value>::KVP value() const
+      {
+        assert(valid());
+        return typename RobinHoodDictionary<T_Key, T_Value>::KVP(
+          dict_->slots_[i_].key, dict_->slots_[i_].value);
+      }
+    private:
+      off_t i_;
+      RobinHoodDictionary<T_Key, T_Value> const* dict_;
+  };
+}
+
+#endif
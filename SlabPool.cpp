@@ -0,0 +1,110 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/SlabPool.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <new>
+#include <utility>
+
+using namespace Base;
+
+SlabPool::SlabPool(size_t objectSize, size_t alignment, Allocator* alloc) :
+  objectSize_(0),
+  alignment_(std::max(alignment, alignof(FreeObject))),
+  alloc_(alloc),
+  free_(nullptr),
+  cursor_(nullptr),
+  end_(nullptr),
+  slabs_(nullptr),
+  nextSlabObjects_(MinSlabObjects),
+  reserved_(0)
+{
+  assert((alignment_ & (alignment_ - 1)) == 0);
+  // Objects double as free list links and every one starts aligned
+  objectSize = std::max(objectSize, sizeof(FreeObject));
+  objectSize_ = (objectSize + alignment_ - 1) & ~(alignment_ - 1);
+}
+
+SlabPool::SlabPool(SlabPool&& pool) noexcept :
+  objectSize_(pool.objectSize_),
+  alignment_(pool.alignment_),
+  alloc_(pool.alloc_),
+  free_(pool.free_),
+  cursor_(pool.cursor_),
+  end_(pool.end_),
+  slabs_(pool.slabs_),
+  nextSlabObjects_(pool.nextSlabObjects_),
+  reserved_(pool.reserved_)
+{
+  pool.free_ = nullptr;
+  pool.cursor_ = nullptr;
+  pool.end_ = nullptr;
+  pool.slabs_ = nullptr;
+  pool.nextSlabObjects_ = MinSlabObjects;
+  pool.reserved_ = 0;
+}
+
+SlabPool& SlabPool::operator= (SlabPool&& pool) noexcept
+{
+  if (&pool == this)
+    return *this;
+  this->~SlabPool();
+  new(this)SlabPool(std::move(pool));
+  return *this;
+}
+
+SlabPool::~SlabPool()
+{
+  clear();
+}
+
+void SlabPool::clear()
+{
+  while (slabs_ != nullptr) {
+    Slab* next = slabs_->next;
+    Base::release(alloc_, slabs_, slabs_->size);
+    slabs_ = next;
+  }
+  free_ = nullptr;
+  cursor_ = nullptr;
+  end_ = nullptr;
+  nextSlabObjects_ = MinSlabObjects;
+  reserved_ = 0;
+}
+
+void* SlabPool::allocateSlab()
+{
+  size_t header = (sizeof(Slab) + alignment_ - 1) & ~(alignment_ - 1);
+  size_t objects = nextSlabObjects_;
+  size_t size = header + objects * objectSize_;
+  // The allocator only promises max_align_t, so leave room to align up
+  if (alignment_ > alignof(max_align_t))
+    size += alignment_;
+  Slab* slab = (Slab*)Base::allocate(alloc_, size);
+  slab->next = slabs_;
+  slab->size = size;
+  slabs_ = slab;
+  reserved_ += size;
+  if ((objects * 2 + 1) * objectSize_ <= MaxSlabBytes)
+    nextSlabObjects_ = objects * 2;
+
+  uintptr_t start = ((uintptr_t)slab + header + alignment_ - 1) & ~(uintptr_t)(alignment_ - 1);
+  cursor_ = (char*)start + objectSize_;
+  end_ = (char*)start + objects * objectSize_;
+  return (void*)start;
+}
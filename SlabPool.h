@@ -0,0 +1,102 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_SlabPool_h
+#define __Base_SlabPool_h
+
+#include "Base/Allocator.h"
+#include "Base/compat/sizes.h"
+#include "Base/compat/stdint.h"
+#include <stddef.h>
+
+namespace Base
+{
+  // Pool of fixed size objects carved from slabs taken from an Allocator
+  // (malloc when null). Released objects go on an intrusive free list and
+  // are handed out again before any new slab space; slabs are only given
+  // back, all at once, by clear or the destructor, which do not run any
+  // destructors of their own. Slabs start at MinSlabObjects objects and
+  // double until the next one would pass MaxSlabBytes (1 MB), so small
+  // pools stay small. Not thread safe.
+  class SlabPool {
+    public:
+      SlabPool(size_t objectSize, size_t alignment = alignof(max_align_t),
+               Allocator* alloc = nullptr);
+      SlabPool(SlabPool&& pool) noexcept;
+      SlabPool& operator= (SlabPool&& pool) noexcept;
+      SlabPool(SlabPool const&) = delete;
+      SlabPool& operator= (SlabPool const&) = delete;
+      ~SlabPool();
+
+      void* allocate()
+      {
+        if (free_ != nullptr) {
+          FreeObject* object = free_;
+          free_ = object->next;
+          return object;
+        }
+        if (cursor_ != end_) {
+          void* object = cursor_;
+          cursor_ += objectSize_;
+          return object;
+        }
+        return allocateSlab();
+      }
+
+      void release(void* object)
+      {
+        FreeObject* freed = (FreeObject*)object;
+        freed->next = free_;
+        free_ = freed;
+      }
+
+      // Gives back every slab; objects from the pool must already be
+      // destroyed and are not to be used again
+      void clear();
+
+      size_t objectSize() const { return objectSize_; }
+      // Bytes held from the allocator
+      size_t reserved() const { return reserved_; }
+      Allocator* allocator() const { return alloc_; }
+
+    private:
+      static constexpr size_t MinSlabObjects = 16;
+      static constexpr size_t MaxSlabBytes = SZ_1M;
+
+      struct Slab {
+        Slab* next;
+        size_t size;
+      };
+
+      struct FreeObject {
+        FreeObject* next;
+      };
+
+      size_t objectSize_;
+      size_t alignment_;
+      Allocator* alloc_;
+      FreeObject* free_;
+      char* cursor_;
+      char* end_;
+      Slab* slabs_;
+      size_t nextSlabObjects_;
+      size_t reserved_;
+
+      void* allocateSlab();
+  };
+}
+
+#endif
@@ -0,0 +1,433 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Sort_h
+#define __Base_Sort_h
+
+#include "Base/Allocator.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Base
+{
+  // Ordering used when no comparison is given
+  template <typename T>
+  struct Less {
+    bool operator()(T const& a, T const& b) const
+    {
+      return a < b;
+    }
+  };
+
+  namespace SortImpl
+  {
+    // Ranges at most this long are insertion sorted
+    static const size_t InsertionLimit = 24;
+    // Ranges longer than this pick a pseudomedian of nine pivot
+    static const size_t NintherLimit = 128;
+    // partialInsertionSort gives up after moving this many items
+    static const size_t PartialLimit = 8;
+
+    template <typename T, typename C>
+    void insertionSort(T* begin, T* end, C& compare)
+    {
+      if (begin == end)
+        return;
+      for (T* i = begin + 1; i < end; i++) {
+        if (!compare(*i, *(i - 1)))
+          continue;
+        T item(std::move(*i));
+        T* j = i;
+        do {
+          *j = std::move(*(j - 1));
+          j--;
+        } while (j > begin && compare(item, *(j - 1)));
+        *j = std::move(item);
+      }
+    }
+
+    // As insertionSort, when an item no greater than any in the range sits
+    // just before begin and stops the scan
+    template <typename T, typename C>
+    void unguardedInsertionSort(T* begin, T* end, C& compare)
+    {
+      if (begin == end)
+        return;
+      for (T* i = begin + 1; i < end; i++) {
+        if (!compare(*i, *(i - 1)))
+          continue;
+        T item(std::move(*i));
+        T* j = i;
+        do {
+          *j = std::move(*(j - 1));
+          j--;
+        } while (compare(item, *(j - 1)));
+        *j = std::move(item);
+      }
+    }
+
+    // Insertion sort that returns false, leaving the range partly sorted,
+    // once it has moved more than PartialLimit items
+    template <typename T, typename C>
+    bool partialInsertionSort(T* begin, T* end, C& compare)
+    {
+      if (begin == end)
+        return true;
+      size_t moved = 0;
+      for (T* i = begin + 1; i < end; i++) {
+        if (!compare(*i, *(i - 1)))
+          continue;
+        T item(std::move(*i));
+        T* j = i;
+        do {
+          *j = std::move(*(j - 1));
+          j--;
+        } while (j > begin && compare(item, *(j - 1)));
+        *j = std::move(item);
+        moved += i - j;
+        if (moved > PartialLimit)
+          return false;
+      }
+      return true;
+    }
+
+    template <typename T, typename C>
+    void sort2(T* a, T* b, C& compare)
+    {
+      if (compare(*b, *a))
+        std::swap(*a, *b);
+    }
+
+    template <typename T, typename C>
+    void sort3(T* a, T* b, T* c, C& compare)
+    {
+      sort2(a, b, compare);
+      sort2(b, c, compare);
+      sort2(a, b, compare);
+    }
+
+    // Partitions around the pivot at *begin, putting items equal to it on
+    // the right. An item no less than the pivot must lie at the end of the
+    // range. Returns the pivot's final place, and whether the range was
+    // already partitioned.
+    template <typename T, typename C>
+    std::pair<T*, bool> partitionRight(T* begin, T* end, C& compare)
+    {
+      T pivot(std::move(*begin));
+      T* first = begin;
+      T* last = end;
+      while (compare(*++first, pivot))
+        ;
+      if (first - 1 == begin) {
+        while (first < last && !compare(*--last, pivot))
+          ;
+      } else {
+        while (!compare(*--last, pivot))
+          ;
+      }
+      bool partitioned = first >= last;
+      while (first < last) {
+        std::swap(*first, *last);
+        while (compare(*++first, pivot))
+          ;
+        while (!compare(*--last, pivot))
+          ;
+      }
+      T* pivotPos = first - 1;
+      *begin = std::move(*pivotPos);
+      *pivotPos = std::move(pivot);
+      return std::make_pair(pivotPos, partitioned);
+    }
+
+    // Partitions around *begin, putting items equal to it on the left.
+    // Used when the pivot equals the item before the range, so everything
+    // equal to it is already in place and only the rest needs sorting.
+    template <typename T, typename C>
+    T* partitionLeft(T* begin, T* end, C& compare)
+    {
+      T pivot(std::move(*begin));
+      T* first = begin;
+      T* last = end;
+      while (compare(pivot, *--last))
+        ;
+      if (last + 1 == end) {
+        while (first < last && !compare(pivot, *++first))
+          ;
+      } else {
+        while (!compare(pivot, *++first))
+          ;
+      }
+      while (first < last) {
+        std::swap(*first, *last);
+        while (compare(pivot, *--last))
+          ;
+        while (!compare(pivot, *++first))
+          ;
+      }
+      *begin = std::move(*last);
+      *last = std::move(pivot);
+      return last;
+    }
+
+    template <typename T, typename C>
+    void heapSort(T* begin, T* end, C& compare)
+    {
+      auto less = [&compare](T const& a, T const& b) { return compare(a, b); };
+      std::make_heap(begin, end, less);
+      std::sort_heap(begin, end, less);
+    }
+
+    // Pattern-defeating quicksort (Peters, 2021). Introsort that also
+    // finishes already sorted runs with a bounded insertion sort, handles
+    // runs of equal items in linear time, and breaks up patterns that
+    // give bad pivots, falling back to heapsort if they keep coming.
+    template <typename T, typename C>
+    void pdqsort(T* begin, T* end, C& compare, int badAllowed, bool leftmost)
+    {
+      for (;;) {
+        size_t size = end - begin;
+        if (size <= InsertionLimit) {
+          if (leftmost)
+            insertionSort(begin, end, compare);
+          else
+            unguardedInsertionSort(begin, end, compare);
+          return;
+        }
+
+        size_t half = size / 2;
+        if (size > NintherLimit) {
+          sort3(begin, begin + half, end - 1, compare);
+          sort3(begin + 1, begin + (half - 1), end - 2, compare);
+          sort3(begin + 2, begin + (half + 1), end - 3, compare);
+          sort3(begin + (half - 1), begin + half, begin + (half + 1), compare);
+          std::swap(*begin, *(begin + half));
+        } else {
+          sort3(begin + half, begin, end - 1, compare);
+        }
+
+        if (!leftmost && !compare(*(begin - 1), *begin)) {
+          begin = partitionLeft(begin, end, compare) + 1;
+          continue;
+        }
+
+        std::pair<T*, bool> part = partitionRight(begin, end, compare);
+        T* pivot = part.first;
+        size_t left = pivot - begin;
+        size_t right = end - (pivot + 1);
+
+        if (left < size / 8 || right < size / 8) {
+          if (--badAllowed == 0) {
+            heapSort(begin, end, compare);
+            return;
+          }
+          // Swap some items around so the next pivots come out differently
+          if (left >= InsertionLimit) {
+            std::swap(begin[0], begin[left / 4]);
+            std::swap(pivot[-1], pivot[-(ssize_t)(left / 4)]);
+            if (left > NintherLimit) {
+              std::swap(begin[1], begin[left / 4 + 1]);
+              std::swap(begin[2], begin[left / 4 + 2]);
+              std::swap(pivot[-2], pivot[-(ssize_t)(left / 4 + 1)]);
+              std::swap(pivot[-3], pivot[-(ssize_t)(left / 4 + 2)]);
+            }
+          }
+          if (right >= InsertionLimit) {
+            std::swap(pivot[1], pivot[1 + right / 4]);
+            std::swap(end[-1], end[-(ssize_t)(right / 4)]);
+            if (right > NintherLimit) {
+              std::swap(pivot[2], pivot[2 + right / 4]);
+              std::swap(pivot[3], pivot[3 + right / 4]);
+              std::swap(end[-2], end[-(ssize_t)(1 + right / 4)]);
+              std::swap(end[-3], end[-(ssize_t)(2 + right / 4)]);
+            }
+          }
+        } else if (part.second &&
+                   partialInsertionSort(begin, pivot, compare) &&
+                   partialInsertionSort(pivot + 1, end, compare)) {
+          return;
+        }
+
+        // Recurse into the left side and loop on the right
+        pdqsort(begin, pivot, compare, badAllowed, leftmost);
+        begin = pivot + 1;
+        leftmost = false;
+      }
+    }
+
+    // Sorts [items, items + count) using scratch, which has room for the
+    // first half, merging each half back only when they overlap
+    template <typename T, typename C>
+    void mergeSort(T* items, size_t count, T* scratch, C& compare)
+    {
+      if (count <= InsertionLimit) {
+        insertionSort(items, items + count, compare);
+        return;
+      }
+      size_t half = count / 2;
+      mergeSort(items, half, scratch, compare);
+      mergeSort(items + half, count - half, scratch, compare);
+      if (!compare(items[half], items[half - 1]))
+        return;
+
+      for (size_t i = 0; i < half; i++)
+        new (&scratch[i])T(std::move(items[i]));
+      T* left = scratch;
+      T* leftEnd = scratch + half;
+      T* right = items + half;
+      T* rightEnd = items + count;
+      T* out = items;
+      // Ties take the left item, which keeps the sort stable
+      while (left < leftEnd && right < rightEnd) {
+        if (compare(*right, *left))
+          *out++ = std::move(*right++);
+        else
+          *out++ = std::move(*left++);
+      }
+      while (left < leftEnd)
+        *out++ = std::move(*left++);
+      for (size_t i = 0; i < half; i++)
+        scratch[i].~T();
+    }
+
+    // Least significant digit radix sort on integers, a byte per pass.
+    // Passes where every item has the same byte are skipped. Stable.
+    template <typename T>
+    void radixSort(T* items, size_t count)
+    {
+      typedef typename std::make_unsigned<T>::type U;
+      static const size_t Bytes = sizeof(T);
+      // Flipping the sign bit orders signed values as unsigned ones
+      const U flip = std::is_signed<T>::value ? (U)((U)1 << (Bytes * 8 - 1)) : 0;
+
+      size_t counts[Bytes][256];
+      memset(counts, 0, sizeof(counts));
+      for (size_t i = 0; i < count; i++) {
+        U key = (U)items[i] ^ flip;
+        for (size_t b = 0; b < Bytes; b++)
+          counts[b][(key >> (b * 8)) & 0xff]++;
+      }
+
+      T* scratch = (T*)allocate(nullptr, sizeof(T) * count);
+      T* from = items;
+      T* to = scratch;
+      for (size_t b = 0; b < Bytes; b++) {
+        size_t* digit = counts[b];
+        if (digit[(((U)items[0] ^ flip) >> (b * 8)) & 0xff] == count)
+          continue;
+        size_t offset = 0;
+        for (size_t d = 0; d < 256; d++) {
+          size_t n = digit[d];
+          digit[d] = offset;
+          offset += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+          U key = (U)from[i] ^ flip;
+          to[digit[(key >> (b * 8)) & 0xff]++] = from[i];
+        }
+        std::swap(from, to);
+      }
+      if (from != items)
+        memcpy(items, from, sizeof(T) * count);
+      release(nullptr, scratch, sizeof(T) * count);
+    }
+
+    // Below this radix sort loses to pdqsort
+    static const size_t RadixThreshold = 256;
+
+    inline int log2(size_t value)
+    {
+      int ret = 0;
+      while (value >>= 1)
+        ret++;
+      return ret;
+    }
+  }
+
+  // Sorts count items in place with pattern-defeating quicksort. Not
+  // stable; O(n log n) worst case, O(n) on sorted or equal runs.
+  template <typename T, typename C>
+  void sortRange(T* items, size_t count, C compare)
+  {
+    if (count < 2)
+      return;
+    SortImpl::pdqsort(items, items + count, compare, SortImpl::log2(count), true);
+  }
+
+  // Stable merge sort; needs scratch space for half the items
+  template <typename T, typename C>
+  void stableSortRange(T* items, size_t count, C compare)
+  {
+    if (count < 2)
+      return;
+    if (count <= SortImpl::InsertionLimit) {
+      SortImpl::insertionSort(items, items + count, compare);
+      return;
+    }
+    size_t scratchSize = sizeof(T) * (count / 2 + 1);
+    T* scratch = (T*)allocate(nullptr, scratchSize);
+    try {
+      SortImpl::mergeSort(items, count, scratch, compare);
+    } catch (...) {
+      release(nullptr, scratch, scratchSize);
+      throw;
+    }
+    release(nullptr, scratch, scratchSize);
+  }
+
+  // How List::sort and stableSort order items when given no comparison.
+  // Specialized where something faster than comparisons applies.
+  template <typename T, typename Enable = void>
+  struct DefaultSort {
+    static void sort(T* items, size_t count)
+    {
+      sortRange(items, count, Less<T>());
+    }
+
+    static void stableSort(T* items, size_t count)
+    {
+      stableSortRange(items, count, Less<T>());
+    }
+  };
+
+  template <typename T>
+  struct DefaultSort<T, typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+    static void sort(T* items, size_t count)
+    {
+      if (count < SortImpl::RadixThreshold)
+        sortRange(items, count, Less<T>());
+      else
+        SortImpl::radixSort(items, count);
+    }
+
+    // Radix sort is already stable
+    static void stableSort(T* items, size_t count)
+    {
+      if (count < SortImpl::RadixThreshold)
+        stableSortRange(items, count, Less<T>());
+      else
+        SortImpl::radixSort(items, count);
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,163 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_SpscQueue_h
+#define __Base_SpscQueue_h
+
+#include "Base/List.h"
+#include "Base/compat/sizes.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace Base
+{
+  // Fixed size ring for exactly one producer thread and one consumer
+  // thread. first/last only ever increase and are masked into the ring;
+  // each side keeps a cached copy of the other side's index and only
+  // reloads it when the ring looks full (producer) or empty (consumer).
+  template <typename T>
+  class SpscQueue {
+    public:
+      SpscQueue(size_t containerSize) :
+        first_(0),
+        lastCache_(0),
+        last_(0),
+        firstCache_(0),
+        items_(nullptr),
+        size_(1)
+      {
+        assert(containerSize > 0);
+        while (size_ < containerSize)
+          size_ *= 2;
+        items_ = (T*)malloc(sizeof(T) * size_);
+        if (items_ == nullptr)
+          throw std::bad_alloc();
+      }
+
+      SpscQueue(SpscQueue<T> const&) = delete;
+      SpscQueue<T>& operator= (SpscQueue<T> const&) = delete;
+
+      bool enqueue(T const& item)
+      {
+        return emplace(item);
+      }
+
+      bool enqueue(T&& item)
+      {
+        return emplace(std::move(item));
+      }
+
+      template <typename... Args>
+      bool emplace(Args&&... args)
+      {
+        size_t last = last_.load(std::memory_order_relaxed);
+        if (last - firstCache_ == size_) {
+          firstCache_ = first_.load(std::memory_order_acquire);
+          if (last - firstCache_ == size_)
+            return false;
+        }
+        new (&items_[last & (size_ - 1)])T(std::forward<Args>(args)...);
+        last_.store(last + 1, std::memory_order_release);
+        return true;
+      }
+
+      size_t enqueue(T const* items, size_t count)
+      {
+        assert(items != nullptr);
+        size_t last = last_.load(std::memory_order_relaxed);
+        if (size_ - (last - firstCache_) < count)
+          firstCache_ = first_.load(std::memory_order_acquire);
+        count = std::min(count, size_ - (last - firstCache_));
+        for (off_t i = 0; i < (ssize_t)count; ++i) {
+          try {
+            new (&items_[(last + i) & (size_ - 1)])T(items[i]);
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              items_[(last + j) & (size_ - 1)].~T();
+            throw;
+          }
+        }
+        last_.store(last + count, std::memory_order_release);
+        return count;
+      }
+
+      bool dequeue(T& item)
+      {
+        size_t first = first_.load(std::memory_order_relaxed);
+        if (first == lastCache_) {
+          lastCache_ = last_.load(std::memory_order_acquire);
+          if (first == lastCache_)
+            return false;
+        }
+        T& slot = items_[first & (size_ - 1)];
+        item = std::move(slot);
+        slot.~T();
+        first_.store(first + 1, std::memory_order_release);
+        return true;
+      }
+
+      size_t dequeue(List<T>& list, size_t count)
+      {
+        size_t first = first_.load(std::memory_order_relaxed);
+        if (lastCache_ - first < count)
+          lastCache_ = last_.load(std::memory_order_acquire);
+        count = std::min(count, lastCache_ - first);
+        list.size(std::max(list.size(), list.count() + count));
+        for (off_t i = 0; i < (ssize_t)count; ++i) {
+          T& slot = items_[(first + i) & (size_ - 1)];
+          list.add(std::move(slot));
+          slot.~T();
+        }
+        first_.store(first + count, std::memory_order_release);
+        return count;
+      }
+
+      size_t count() const
+      {
+        size_t first = first_.load(std::memory_order_acquire);
+        return last_.load(std::memory_order_acquire) - first;
+      }
+
+      size_t size() const
+      {
+        return size_;
+      }
+
+      ~SpscQueue()
+      {
+        size_t last = last_.load(std::memory_order_acquire);
+        for (size_t i = first_.load(std::memory_order_acquire); i != last; i++)
+          items_[i & (size_ - 1)].~T();
+        free(items_);
+      }
+
+    private:
+      //consumer owned
+      alignas(SZ_CACHE_LINE) std::atomic<size_t> first_;
+      size_t lastCache_;
+      //producer owned
+      alignas(SZ_CACHE_LINE) std::atomic<size_t> last_;
+      size_t firstCache_;
+      //shared, read only
+      alignas(SZ_CACHE_LINE) T* items_;
+      size_t size_;
+  };
+}
+
+#endif
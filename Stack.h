@@ -18,89 +18,200 @@
 #define __Base_Stack_h
 
 #include "Base/List.h"
+#include "Base/Stats.h"
 
 namespace Base
 {
   template <typename T>
   class Stack {
     public:
-      Stack(T const* items, size_t count, size_t containerSize = 0) :
+      Stack(T const* items, size_t count, size_t containerSize = 0,
+            Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(count),
-        size_(std::max(count, containerSize))
+        size_(std::max(count, containerSize)),
+        alloc_(alloc)
       {
         assert(items != nullptr);
-        items_ = new T[size_];
-        for (off_t i = 0; i < count; ++i)
-          items_[i] = items[i];
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<Stack<T>>().allocated(sizeof(T) * size_);
+        Stats::of<Stack<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count; ++i) {
+          try {
+            new (&items_[i])T(items[i]);
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              items_[j].~T();
+            release(alloc_, items_, sizeof(T) * size_);
+            throw;
+          }
+        }
       }
 
-      Stack(size_t containerSize = 0) :
+      Stack(size_t containerSize = 0, Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(0),
-        size_(containerSize)
+        size_(containerSize),
+        alloc_(alloc)
       {
-        if (size_ > 0)
-          items_ = new T[size_];
+        if (size_ > 0) {
+          items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+          Stats::of<Stack<T>>().allocated(sizeof(T) * size_);
+        }
       }
 
-      Stack(Stack<T> const& value) :
+      Stack(Stack<T> const& value, Allocator* alloc = nullptr) :
         items_(nullptr),
         count_(value.count_),
-        size_(value.size_)
+        size_(value.size_),
+        alloc_(alloc)
       {
-        items_ = new T[size_];
-        for (off_t i = 0; i < count_; ++i)
-          items_[i] = value.items_[i];
+        if (size_ == 0)
+          return;
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<Stack<T>>().allocated(sizeof(T) * size_);
+        Stats::of<Stack<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count_; ++i) {
+          try {
+            new (&items_[i])T(value.items_[i]);
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              items_[j].~T();
+            release(alloc_, items_, sizeof(T) * size_);
+            throw;
+          }
+        }
       }
 
-      Stack(List<T> const& value) :
+      Stack(Stack<T>&& value) noexcept :
+        items_(value.items_),
+        count_(value.count_),
+        size_(value.size_),
+        alloc_(value.alloc_)
+      {
+        value.items_ = nullptr;
+        value.count_ = 0;
+        value.size_ = 0;
+      }
+
+      Stack(List<T> const& value, Allocator* alloc = nullptr) :
         items_(nullptr),
-        count_(value.getCount()),
-        size_(value.getSize())
+        count_(value.count()),
+        size_(value.size()),
+        alloc_(alloc)
       {
-        items_ = new T[size_];
-        for (off_t i = 0; i < count_; ++i)
-          items_[i] = value[i];
+        if (size_ == 0)
+          return;
+        items_ = (T*)allocate(alloc_, sizeof(T) * size_);
+        Stats::of<Stack<T>>().allocated(sizeof(T) * size_);
+        Stats::of<Stack<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count_; ++i) {
+          try {
+            new (&items_[i])T(value[i]);
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              items_[j].~T();
+            release(alloc_, items_, sizeof(T) * size_);
+            throw;
+          }
+        }
+      }
+
+      Stack<T>& operator= (Stack<T>&& value) noexcept
+      {
+        if (&value == this)
+          return *this;
+        for (off_t i = 0; i < (ssize_t)count_; i++)
+          items_[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
+        items_ = value.items_;
+        count_ = value.count_;
+        size_ = value.size_;
+        alloc_ = value.alloc_;
+        value.items_ = nullptr;
+        value.count_ = 0;
+        value.size_ = 0;
+        return *this;
       }
 
       Stack<T>& operator= (Stack<T> const& value)
       {
         setMinSize(value.count_);
-        for (off_t i = 0; i < value.count_; ++i)
+        Stats::of<Stack<T>>().copied(value.count_);
+        off_t i;
+        for (i = 0; i < (ssize_t)count_ && i < (ssize_t)value.count_; ++i)
           items_[i] = value.items_[i];
+        for (; i < (ssize_t)value.count_; i++) {
+          try {
+            new (&items_[i])T(value.items_[i]);
+          } catch (...) {
+            for (off_t j = count_; j < i; j++)
+              items_[j].~T();
+            throw;
+          }
+        }
+        for (; i < (ssize_t)count_; i++)
+          items_[i].~T();
         count_ = value.count_;
         return *this;
       }
 
       void push(T const& item)
+      {
+        emplace(item);
+      }
+
+      void push(T&& item)
+      {
+        emplace(std::move(item));
+      }
+
+      template <typename... Args>
+      T& emplace(Args&&... args)
       {
         setMinSize(count_ + 1);
-        items_[count_++] = item;
+        new (&items_[count_])T(std::forward<Args>(args)...);
+        return items_[count_++];
       }
 
       void push(T const* items, size_t count = 1)
       {
         assert(items != nullptr);
         setMinSize(count_ + count);
-        for (off_t i = 0; i < count; ++i)
-          items_[i + count_] = items[i];
+        for (off_t i = 0; i < (ssize_t)count; ++i) {
+          try {
+            new (&items_[i + count_])T(items[i]);
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              items_[j + count_].~T();
+            throw;
+          }
+        }
         count_ += count;
       }
 
       void push(List<T> const& items)
       {
-        setMinSize(count_ + items.getCount());
-        for (off_t i = 0; i < items.getCount(); ++i)
-          items_[i + count_] = items[i];
-        count_ += items.getCount();
+        setMinSize(count_ + items.count());
+        for (off_t i = 0; i < (ssize_t)items.count(); ++i) {
+          try {
+            new (&items_[i + count_])T(items[i]);
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              items_[j + count_].~T();
+            throw;
+          }
+        }
+        count_ += items.count();
       }
 
       T pop()
       {
         assert(count_ > 0);
         count_ -= 1;
-        return items_[count_];
+        T val = std::move(items_[count_]);
+        items_[count_].~T();
+        return val;
       }
       
       List<T> pop(size_t count)
@@ -115,9 +226,11 @@ namespace Base
         if (count == 0)
           return;
         assert(count <= count_);
-        for (off_t i = 0; i < count; ++i)
-          list.add(items_[count_ - 1 - i]);
-        count_ -= count;
+        for (off_t i = 0; i < (ssize_t)count; ++i) {
+          list.add(std::move(items_[count_ - 1]));
+          items_[count_ - 1].~T();
+          count_ -= 1;
+        }
       }
 
       size_t getCount() const
@@ -134,17 +247,30 @@ namespace Base
       {
         assert(size >= count_);
         if (size_ == size) return;
-        size_ = size;
-        T* newItems = new T[size_];
-        for (off_t i = 0; i < count_; ++i)
-          newItems[i] = items_[i];
-        delete[] items_;
+        T* newItems = (T*)allocate(alloc_, sizeof(T) * size);
+        Stats::of<Stack<T>>().resized();
+        Stats::of<Stack<T>>().allocated(sizeof(T) * size);
+        Stats::of<Stack<T>>().copied(count_);
+        for (off_t i = 0; i < (ssize_t)count_; ++i) {
+          try {
+            new (&newItems[i])T(std::move_if_noexcept(items_[i]));
+          } catch (...) {
+            for (off_t j = 0; j < i; j++)
+              newItems[j].~T();
+            release(alloc_, newItems, sizeof(T) * size);
+            throw;
+          }
+        }
+        for (off_t i = 0; i < (ssize_t)count_; i++)
+          items_[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
         items_ = newItems;
+        size_ = size;
       }
 
       T& operator[] (off_t index) const
       {
-        assert(index < count_);
+        assert(index < (ssize_t)count_);
         return items_[count_ - 1 - index];
       }
 
@@ -174,31 +300,35 @@ namespace Base
         return *this;
       }
 
+      Stack<T>& operator+= (T&& value)
+      {
+        push(std::move(value));
+        return *this;
+      }
+
+      Allocator* allocator() const
+      {
+        return alloc_;
+      }
+
       ~Stack()
       {
-        delete[] items_;
+        for (off_t i = 0; i < (ssize_t)count_; i++)
+          items_[i].~T();
+        release(alloc_, items_, sizeof(T) * size_);
       }
 
     private:
       T* items_;
       size_t count_;
       size_t size_;
+      Allocator* alloc_;
 
       void setMinSize(size_t size)
       {
-        if (items_ == nullptr)
-        {
-          size_ = size;
-          items_ = new T[size_];
-        }
-        else if (size_ < size)
-        {
-          size_ = std::max(size, size_ * 2);
-          T* newItems = new T[size_];
-          for (off_t i = 0; i < count_; ++i)
-            newItems[i] = items_[i];
-          delete[] items_;
-          items_ = newItems;
+        if (items_ == nullptr || size_ < size) {
+          size = std::max<size_t>(size, size_ * 2);
+          setSize(std::max<size_t>(size, 1));
         }
       }
   };
@@ -0,0 +1,130 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/Stats.h"
+#include "Base/List.h"
+#include "Base/String.h"
+#include "Base/StringBuilder.h"
+
+#ifdef BASE_STATS
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
+
+using namespace Base;
+
+#ifdef BASE_STATS
+
+// Counters are never freed, so the list only grows and is walked without
+// locking
+static std::atomic<Stats::Counters*> registered(nullptr);
+
+Stats::Counters::Counters(char const* mangled) :
+  type_(mangled),
+  next_(nullptr),
+  allocations_(0),
+  bytes_(0),
+  resizes_(0),
+  copies_(0),
+  lookups_(0),
+  probes_(0),
+  maxProbe_(0),
+  maxLoad_(0)
+{
+  int status;
+  char* name = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+  if (status == 0)
+    type_ = name;
+  next_ = registered.load(std::memory_order_relaxed);
+  while (!registered.compare_exchange_weak(next_, this, std::memory_order_release,
+                                           std::memory_order_relaxed))
+    ;
+}
+
+List<Stats::Snapshot> Stats::snapshot()
+{
+  List<Snapshot> ret;
+  for (Counters* c = registered.load(std::memory_order_acquire); c != nullptr; c = c->next_) {
+    ret.add(Snapshot{
+      c->type_,
+      c->allocations_.load(std::memory_order_relaxed),
+      c->bytes_.load(std::memory_order_relaxed),
+      c->resizes_.load(std::memory_order_relaxed),
+      c->copies_.load(std::memory_order_relaxed),
+      c->lookups_.load(std::memory_order_relaxed),
+      c->probes_.load(std::memory_order_relaxed),
+      c->maxProbe_.load(std::memory_order_relaxed),
+      c->maxLoad_.load(std::memory_order_relaxed) / 1024.0
+    });
+  }
+  return ret;
+}
+
+void Stats::reset()
+{
+  for (Counters* c = registered.load(std::memory_order_acquire); c != nullptr; c = c->next_) {
+    c->allocations_.store(0, std::memory_order_relaxed);
+    c->bytes_.store(0, std::memory_order_relaxed);
+    c->resizes_.store(0, std::memory_order_relaxed);
+    c->copies_.store(0, std::memory_order_relaxed);
+    c->lookups_.store(0, std::memory_order_relaxed);
+    c->probes_.store(0, std::memory_order_relaxed);
+    c->maxProbe_.store(0, std::memory_order_relaxed);
+    c->maxLoad_.store(0, std::memory_order_relaxed);
+  }
+}
+
+#else
+
+List<Stats::Snapshot> Stats::snapshot()
+{
+  return List<Snapshot>();
+}
+
+void Stats::reset()
+{
+}
+
+#endif
+
+String Stats::json()
+{
+  List<Snapshot> stats = snapshot();
+  StringBuilder out;
+  out.append('{');
+  for (auto it = stats.iter(); it.valid(); it.next()) {
+    Snapshot const& s = it.value();
+    if (it.i > 0)
+      out.append(',');
+    out.append("\n  \"");
+    for (char const* c = s.type; *c != '\0'; c++) {
+      if (*c == '"' || *c == '\\')
+        out.append('\\');
+      out.append(*c);
+    }
+    out.append("\": {\"allocations\": ").append(s.allocations)
+      .append(", \"bytes\": ").append(s.bytes)
+      .append(", \"resizes\": ").append(s.resizes)
+      .append(", \"copies\": ").append(s.copies)
+      .append(", \"lookups\": ").append(s.lookups)
+      .append(", \"probes\": ").append(s.probes)
+      .append(", \"max_probe\": ").append(s.maxProbe)
+      .append(", \"max_load_factor\": ").append(s.maxLoadFactor)
+      .append('}');
+  }
+  out.append(stats.count() > 0 ? "\n}" : "}");
+  return out.toString();
+}
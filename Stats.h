@@ -0,0 +1,158 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_Stats_h
+#define __Base_Stats_h
+
+#include "Base/compat/stdint.h"
+#include <stddef.h>
+
+#ifdef BASE_STATS
+#include <atomic>
+#include <typeinfo>
+#endif
+
+namespace Base
+{
+  template <typename T>
+  class List;
+  class String;
+
+  // Per-container-type counters of allocations, resizes, element copies and
+  // hash lookups, for tuning initial sizes from real workloads. Recording is
+  // compiled in only when BASE_STATS is defined (the BASE_STATS CMake
+  // option); otherwise Counters is empty, every call on it inlines to
+  // nothing, and snapshot() returns no entries.
+  class Stats {
+    public:
+      struct Snapshot {
+        // Demangled container type, e.g. "Base::List<int>"
+        char const* type;
+        uint64_t allocations;
+        uint64_t bytes;
+        uint64_t resizes;
+        // Elements copied or moved one at a time by resizes and copies
+        uint64_t copies;
+        uint64_t lookups;
+        // Hash chain nodes visited by lookups
+        uint64_t probes;
+        uint64_t maxProbe;
+        double maxLoadFactor;
+      };
+
+#ifdef BASE_STATS
+      class Counters {
+        public:
+          Counters(char const* mangled);
+          Counters(Counters const&) = delete;
+          Counters& operator= (Counters const&) = delete;
+
+          void allocated(size_t bytes)
+          {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(bytes, std::memory_order_relaxed);
+          }
+
+          void resized()
+          {
+            resizes_.fetch_add(1, std::memory_order_relaxed);
+          }
+
+          void copied(size_t count)
+          {
+            copies_.fetch_add(count, std::memory_order_relaxed);
+          }
+
+          void probed(size_t probes)
+          {
+            lookups_.fetch_add(1, std::memory_order_relaxed);
+            probes_.fetch_add(probes, std::memory_order_relaxed);
+            raise(maxProbe_, probes);
+          }
+
+          void loaded(size_t count, size_t capacity)
+          {
+            // Load factor in 1/1024ths, so it fits an integer atomic
+            raise(maxLoad_, capacity == 0 ? 0 : (uint64_t)count * 1024 / capacity);
+          }
+
+        private:
+          friend class Stats;
+
+          char const* type_;
+          Counters* next_;
+          std::atomic<uint64_t> allocations_;
+          std::atomic<uint64_t> bytes_;
+          std::atomic<uint64_t> resizes_;
+          std::atomic<uint64_t> copies_;
+          std::atomic<uint64_t> lookups_;
+          std::atomic<uint64_t> probes_;
+          std::atomic<uint64_t> maxProbe_;
+          std::atomic<uint64_t> maxLoad_;
+
+          static void raise(std::atomic<uint64_t>& max, uint64_t value)
+          {
+            uint64_t seen = max.load(std::memory_order_relaxed);
+            while (value > seen && !max.compare_exchange_weak(seen, value,
+                                                              std::memory_order_relaxed))
+              ;
+          }
+      };
+
+      // Counters for container type C, registered on first use
+      template <typename C>
+      static Counters& of()
+      {
+        static Counters* counters = new Counters(typeid(C).name());
+        return *counters;
+      }
+#else
+      class Counters {
+        public:
+          void allocated(size_t) {}
+          void resized() {}
+          void copied(size_t) {}
+          void probed(size_t) {}
+          void loaded(size_t, size_t) {}
+      };
+
+      template <typename C>
+      static Counters& of()
+      {
+        static Counters counters;
+        return counters;
+      }
+#endif
+
+      static constexpr bool enabled()
+      {
+#ifdef BASE_STATS
+        return true;
+#else
+        return false;
+#endif
+      }
+
+      // Every type recorded so far, in no particular order
+      static List<Snapshot> snapshot();
+      // snapshot() as a JSON object keyed by type
+      static String json();
+      // Zeroes every counter; types stay registered
+      static void reset();
+  };
+}
+
+#endif
@@ -14,535 +14,478 @@
  * License along with this library; if not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "Base/Char.h"
 #include "Base/String.h"
+#include "Base/StringBuilder.h"
 
 #include <string.h>
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 
 using namespace Base;
 using namespace std;
 
-static char const* empty = "";
+// Precedes the chars of a shared buffer
+struct String::SharedHeader {
+  atomic<size_t> refs;
+};
 
-String::String(char const* value) :
-  chars_(nullptr),
-  length_(0),
-  size_(0)
+String::String(char const* value, Allocator* alloc) :
+  alloc_(alloc)
 {
-  length_ = strlen(value);
-  size_ = length_ + 1;
-  chars_ = unique_ptr<char[]>(new char[size_]);
-  assert(length_ < size_);
-  memcpy(chars_.get(), value, length_);
-  chars_[length_] = '\0';
+  size_t len = strlen(value);
+  memcpy(init(len), value, len);
 }
 
 String::String() :
-  chars_(nullptr),
-  length_(0),
-  size_(0)
+  alloc_(nullptr)
 {
+  init(0);
 }
 
+String::String(Allocator* alloc) :
+  alloc_(alloc)
+{
+  init(0);
+}
+
+String::String(String const& value, Allocator* alloc) :
+  alloc_(alloc)
+{
+  if (value.isShared() && alloc == nullptr) {
+    adopt(value);
+    return;
+  }
+  size_t len = value.length();
+  memcpy(init(len), value.chars(), len);
+  hash_.store(value.hash_.load(memory_order_relaxed), memory_order_relaxed);
+}
 
-String::String(String const& value) :
-  chars_(nullptr),
-  length_(value.length_),
-  size_(value.length_ + 1)
+String::String(StringView value, Allocator* alloc) :
+  alloc_(alloc)
 {
-  //make copies for objects in other threads
-  chars_ = unique_ptr<char[]>(new char[size_]);
-  assert(length_ <= size_);
-  memcpy(chars_.get(), value.chars_.get(), length_);
+  memcpy(init(value.length()), value.data(), value.length());
+}
+
+String::String(String&& value) noexcept :
+  alloc_(value.alloc_),
+  hash_(value.hash_.load(memory_order_relaxed))
+{
+  memcpy(inline_, value.inline_, sizeof(inline_));
+  value.init(0);
 }
 
 String::String(char const* inner, size_t len) :
-  chars_(nullptr),
-  length_(len),
-  size_(len + 1)
+  alloc_(nullptr)
+{
+  memcpy(init(len), inner, len);
+}
+
+String::~String()
+{
+  freeChars();
+}
+
+void String::freeChars()
+{
+  if (isInline())
+    return;
+  if (!isShared()) {
+    release(alloc_, heap_.chars, capacity() + 1);
+    return;
+  }
+  SharedHeader* header = sharedHeader();
+  if (header->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+    header->~SharedHeader();
+    release(alloc_, header, sizeof(SharedHeader) + capacity() + 1);
+  }
+}
+
+String::SharedHeader* String::sharedHeader() const
+{
+  return (SharedHeader*)(heap_.chars - sizeof(SharedHeader));
+}
+
+void String::adopt(String const& value)
+{
+  assert(value.isShared());
+  value.sharedHeader()->refs.fetch_add(1, memory_order_relaxed);
+  memcpy(inline_, value.inline_, sizeof(inline_));
+  hash_.store(value.hash_.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+String& String::share()
+{
+  if (isInline() || isShared() || alloc_ != nullptr)
+    return *this;
+  size_t len = length();
+  char* block = (char*)reallocate(alloc_, heap_.chars, capacity() + 1,
+                                  sizeof(SharedHeader) + len + 1);
+  memmove(block + sizeof(SharedHeader), block, len + 1);
+  new (block)SharedHeader{{1}};
+  heap_.chars = block + sizeof(SharedHeader);
+  heap_.size = ((len + 1) << 8) | HeapFlag | SharedFlag;
+  return *this;
+}
+
+bool String::isShared() const
+{
+  return !isInline() && (heap_.size & SharedFlag) != 0;
+}
+
+size_t String::capacity() const
 {
-  chars_ = unique_ptr<char[]>(new char[size_]);
-  assert(length_ < size_);
-  memcpy(chars_.get(), inner, len);
-  chars_[length_] = '\0';
+  if (isInline())
+    return InlineCapacity;
+  return ((heap_.size & ~HeapFlag) >> 8) - 1;
 }
 
-String::String(char const* inner1, size_t len1, char const* inner2, size_t len2) :
-  chars_(nullptr),
-  length_(len1 + len2),
-  size_(len1 + len2 + 1)
+void String::setLength(size_t length)
 {
-  chars_ = unique_ptr<char[]>(new char[size_]);
-  assert(length_ < size_);
-  if (inner1 != nullptr)
-    memcpy(chars_.get(), inner1, len1);
-  memcpy(chars_.get() + len1, inner2, len2);
-  chars_[length_] = '\0';
+  assert(length <= capacity());
+  hash_.store(0, memory_order_relaxed);
+  if (isInline())
+  {
+    inline_[length] = '\0';
+    inline_[InlineCapacity] = InlineCapacity - length;
+  }
+  else
+  {
+    heap_.chars[length] = '\0';
+    heap_.length = length;
+  }
 }
 
-String::String(char const* inner1, char const* inner2, size_t len2) :
-  chars_(nullptr),
-  length_(len2),
-  size_(len2 + 1)
+char* String::init(size_t length)
 {
-  size_t len1 = strlen(inner1);
-  length_ += len1;
-  size_ += len1;
-  chars_ = unique_ptr<char[]>(new char[size_]);
-  assert(length_ < len1 + len2);
-  if (inner1 != nullptr)
-    memcpy(chars_.get(), inner1, len1);
-  memcpy(chars_.get() + len1, inner2, len2);
-  chars_[length_] = '\0';
+  hash_.store(0, memory_order_relaxed);
+  if (length <= InlineCapacity)
+  {
+    inline_[length] = '\0';
+    inline_[InlineCapacity] = InlineCapacity - length;
+    return inline_;
+  }
+  heap_.chars = (char*)allocate(alloc_, length + 1);
+  heap_.chars[length] = '\0';
+  heap_.length = length;
+  heap_.size = ((length + 1) << 8) | HeapFlag;
+  return heap_.chars;
+}
+
+void String::reserve(size_t capacity)
+{
+  size_t current = this->capacity();
+  if (isShared()) {
+    // Sole owner may keep writing in place; otherwise take a private copy
+    if (current >= capacity && sharedHeader()->refs.load(memory_order_acquire) == 1)
+      return;
+    size_t size = std::max(current, capacity) + 1;
+    size_t len = length();
+    char* newChars = (char*)allocate(alloc_, size);
+    memcpy(newChars, heap_.chars, len + 1);
+    freeChars();
+    heap_.chars = newChars;
+    heap_.length = len;
+    heap_.size = (size << 8) | HeapFlag;
+    return;
+  }
+  if (current >= capacity)
+    return;
+  size_t size = std::max<size_t>((current + 1) * 2, capacity + 1);
+  size_t len = length();
+  char* newChars;
+  if (isInline()) {
+    newChars = (char*)allocate(alloc_, size);
+    memcpy(newChars, inline_, len + 1);
+  } else {
+    newChars = (char*)reallocate(alloc_, heap_.chars, current + 1, size);
+  }
+  heap_.chars = newChars;
+  heap_.length = len;
+  heap_.size = (size << 8) | HeapFlag;
 }
 
 String String::substring(off_t index) const
 {
-  assert(index <= (ssize_t)length_);
-  if (index == (ssize_t)length_)
-    return String("");
-  return String(chars_.get() + index, length_ - index);
+  return String(view().substring(index));
 }
 
 String String::substring(off_t index, size_t length) const
 {
-  assert(index <= (ssize_t)length_);
-  assert(index + (ssize_t)length <= (ssize_t)length_);
-  if (length == 0)
-    return String("");
-  else if (length == length_)
+  // The whole string copies (and shares, if shared) its chars
+  if (index == 0 && length == this->length())
     return *this;
-  return String(chars_.get() + index, length);
+  return String(view().substring(index, length));
 }
 
 bool String::contains(String const& value) const
 {
-  if (value == "")
-    return true;
-  for (off_t i = 0; i <= (ssize_t)length_ - (ssize_t)value.length_; ++i)
-  {
-    if (partEq(chars_.get() + i, value.chars_.get(), value.length_))
-      return true;
-  }
-  return false;
+  return view().contains(value.view());
 }
 
 bool String::contains(char const* value) const
 {
   assert(value != nullptr);
-  if (value[0] == '\0')
-    return true;
-  ssize_t len = strlen(value);
-  if (len > (ssize_t)length_) return false;
-  for (off_t i = 0; i <= (ssize_t)length_ - (ssize_t)len; ++i)
-  {
-    if (partEq(chars_.get() + i, value, len))
-      return true;
-  }
-  return false;
+  return view().contains(StringView(value));
 }
 
-bool String::partEq(char const* inner, char const* test, size_t testLen) const
+bool String::contains(StringView value) const
 {
-  for (off_t i = 0; i < (ssize_t)testLen; ++i)
-  {
-    if (inner[i] != test[i])
-      return false;
-  }
-  return true;
+  return view().contains(value);
 }
 
 String String::replace(char const* find, char const* replace) const
 {
   assert(find != nullptr);
   assert(replace != nullptr);
-  ssize_t findLen = strlen(find);
-  assert(findLen > 0);
-  String ret;
-  for (off_t i = 0; i < (ssize_t)length_; ++i)
-  {
-    if (i <= (ssize_t)length_ - findLen && partEq(chars_.get() + i, find, findLen))
-    {
-      ret += replace;
-      i += findLen - 1;
-    }
-    else
-    {
-      ret += chars_[i];
-    }
-  }
-  return ret;
+  return this->replace(StringView(find), StringView(replace));
 }
 
 String String::replace(String const& find, String const& replace) const
 {
-  assert(find.length_ > 0);
-  String ret;
-  for (off_t i = 0; i < (ssize_t)length_; ++i)
+  return this->replace(find.view(), replace.view());
+}
+
+String String::replace(StringView find, StringView replace) const
+{
+  assert(find.length() > 0);
+  StringView rest = view();
+  StringBuilder ret;
+  off_t index;
+  while ((index = rest.indexOf(find)) >= 0)
   {
-    if (i <= (ssize_t)length_ - (ssize_t)find.length_ && partEq(chars_.get() + i, find.chars_.get(), find.length_))
-    {
-      ret += replace;
-      i += find.length_ - 1;
-    }
-    else
-    {
-      ret += chars_[i];
-    }
+    ret << rest.substring(0, index) << replace;
+    rest = rest.substring(index + find.length());
   }
-  return ret;
+  ret << rest;
+  return ret.toString();
 }
 
 String String::ltrim()
 {
-  if (length_ == 0 || !Char::isWhitespace((*this)[0]))
-	return *this;
-  for (off_t i = 1; i < (ssize_t)length_; i++) {
-    if (!Char::isWhitespace((*this)[i]))
-      return this->substring(i);
-  }
-  return "";
+  StringView trimmed = view().ltrim();
+  if (trimmed.length() == length())
+    return *this;
+  return String(trimmed);
 }
 
 String String::rtrim()
 {
-  if (length_ == 0 || !Char::isWhitespace((*this)[-1]))
+  StringView trimmed = view().rtrim();
+  if (trimmed.length() == length())
     return *this;
-  for (off_t i = -1; i > -(ssize_t)length_; i--) {
-    if (!Char::isWhitespace((*this)[i]))
-      return this->substring(0, length_ + i + 1);
-  }
-  return "";
+  return String(trimmed);
 }
 
 String String::trim()
 {
-  off_t lhs = length_;
-  if (length_ == 0 ||
-      (!Char::isWhitespace((*this)[0]) && !Char::isWhitespace((*this)[-1])))
+  StringView trimmed = view().trim();
+  if (trimmed.length() == length())
     return *this;
-  for (off_t i = 0; i < (ssize_t)length_; i++) {
-    if (!Char::isWhitespace((*this)[i])) {
-      lhs = i;
-      break;
-    }
-  }
-  off_t rhs = 0;
-  for (off_t i = length_ - 1; i >= 0; i--) {
-    if (!Char::isWhitespace((*this)[i])) {
-      rhs = i;
-      break;
-    }
-  }
-  if (rhs <= lhs)
-    return "";
-  return this->substring(lhs, rhs - lhs + 1);
-}
-
-off_t String::indexOf(const char* str) {
-  size_t len = strlen(str);
-  if (len == 0)
-    return 0;
-  for (off_t i = 0; i <= (ssize_t)(length_ - len); i++) {
-    if ((*this)[i] == str[0]) {
-      bool found = true;
-      for (off_t j = 0; j < (ssize_t)len; j++) {
-        if ((*this)[i+j] != str[j]) {
-          found = false;
-	  break;
-	}
-      }
-      if (found)
-        return i;
-    }
-  }
-  return -1;
-}
-
-off_t String::indexOfR(const char* str) {
-  size_t len = strlen(str);
-  if (len == 0)
-    return -1;
-  for (off_t i = -1; i >= -(ssize_t)length_; i--) {
-    if ((*this)[i] == str[len - 1]) {
-      bool found = true;
-      for (off_t j = 1; j < (ssize_t)len; j++) {
-        if ((*this)[i-j] == str[len-j]) {
-          found = false;
-	        break;
-	      }
-      }
-      if (found)
-        return length_ + i - len + 1;
-    }
-  }
-  return -1;
+  return String(trimmed);
+}
+
+off_t String::indexOf(const char* str) const
+{
+  return view().indexOf(StringView(str));
+}
+
+off_t String::indexOfR(const char* str) const
+{
+  return view().indexOfR(StringView(str));
 }
 
 List<String> String::split(char const* separator) const
 {
   assert(separator != nullptr);
-  ssize_t sepLen = strlen(separator);
-  assert(sepLen > 0);
-  List<String> ret;
-  String part;
-  for (off_t i = 0; i < (ssize_t)length_; i++)
-  {
-    if (i <= (ssize_t)length_ - (ssize_t)sepLen && partEq(chars_.get() + i, separator, sepLen))
-    {
-      ret += part;
-      part = "";
-      i += sepLen - 1;
-    }
-    else
-    {
-      part += chars_[i];
-    }
-  }
-  ret += part;
-  return ret;
+  return split(StringView(separator));
 }
 
 List<String> String::split(String const& separator) const
 {
-  assert(separator.length_ > 0);
+  return split(separator.view());
+}
+
+List<String> String::split(StringView separator) const
+{
+  assert(separator.length() > 0);
   List<String> ret;
-  String part;
-  for (off_t i = 0; i < (ssize_t)length_; i++)
-  {
-    if (i <= (ssize_t)length_ - (ssize_t)separator.length_ && partEq(chars_.get() + i, separator.chars_.get(), separator.length_))
-    {
-      ret += part;
-      part = "";
-      i += separator.length_ - 1;
-    }
-    else
-    {
-      part += chars_[i];
-    }
-  }
-  ret += part;
+  for (StringSplitIter it = view().split(separator); it.valid(); it.next())
+    ret.emplace(it.value());
   return ret;
 }
 
 bool String::startsWith(char const* value) const
 {
-  ssize_t len = strlen(value);
-  if (len > (ssize_t)length_)
-    return false;
-  for (off_t i = 0; i < len; ++i)
-  {
-    if (chars_[i] != value[i])
-      return false;
-  }
-  return true;
+  return view().startsWith(StringView(value));
 }
 
 bool String::startsWith(String const& value) const
 {
-  if (value.length_ > length_)
-    return false;
-  for (off_t i = 0; i < (ssize_t)value.length_; ++i)
-  {
-    if (chars_[i] != value.chars_[i])
-      return false;
-  }
-  return true;
+  return view().startsWith(value.view());
+}
+
+bool String::startsWith(StringView value) const
+{
+  return view().startsWith(value);
 }
 
 bool String::endsWith(char const* value) const
 {
-  ssize_t len = strlen(value);
-  if (len > (ssize_t)length_)
-    return false;
-  off_t start = length_ - len;
-  for (off_t i = start; i < (ssize_t)length_; ++i)
-  {
-    if (chars_[i] != value[i - start])
-      return false;
-  }
-  return true;
+  return view().endsWith(StringView(value));
 }
 
 bool String::endsWith(String const& value) const
 {
-  if (value.length_ > length_)
-    return false;
-  off_t start = length_ - value.length_;
-  for (off_t i = start; i < (ssize_t)length_; ++i)
-  {
-    if (chars_[i] != value.chars_[i - start])
-      return false;
-  }
-  return true;
+  return view().endsWith(value.view());
+}
+
+bool String::endsWith(StringView value) const
+{
+  return view().endsWith(value);
 }
 
 void String::copyTo(char* charBuffer) const
 {
-  if (chars_ == nullptr)
-  {
-    charBuffer[0] = '\0';
-  }
-  else
-  {
-    memcpy(charBuffer, chars_.get(), length_ + 1);
-  }
+  memcpy(charBuffer, chars(), length() + 1);
 }
 
 char const* String::c_str() const
 {
-  return chars_ == nullptr ? empty : chars_.get();
+  return chars();
 }
 
 size_t String::length() const
 {
-  return length_;
+  if (isInline())
+    return InlineCapacity - inline_[InlineCapacity];
+  return heap_.length;
 }
 
-int String::hash() const
+uint64_t String::hash() const
 {
-  int hash = 0;
-  for (off_t i = 0; i < (ssize_t)this->length(); i++) {
-    hash = (hash << 1) | (hash >> (sizeof(hash) * 8 - 1));
-    hash ^= (*this)[i];
+  // 0 doubles as "not computed"; a real hash of 0 is just recomputed
+  uint64_t ret = hash_.load(memory_order_relaxed);
+  if (ret == 0) {
+    ret = view().hash();
+    hash_.store(ret, memory_order_relaxed);
   }
-  return hash;
+  return ret;
 }
 
 String& String::operator= (String const& value)
 {
-  if (value.length_ + 1 > size_)
+  if (&value == this)
+    return *this;
+  if (value.isShared() && alloc_ == nullptr) {
+    if (!isShared() || heap_.chars != value.heap_.chars) {
+      freeChars();
+      adopt(value);
+    }
+    return *this;
+  }
+  size_t len = value.length();
+  if (len > capacity() || isShared())
   {
-    size_ = value.length_ + 1;
-    chars_ = unique_ptr<char[]>(new char[size_]);
+    freeChars();
+    init(len);
   }
-  length_ = value.length_;
-  assert(length_ < size_);
-  assert(length_ <= value.length_);
-  memcpy(chars_.get(), value.chars_.get(), length_);
-  chars_[length_] = '\0';
+  memcpy(chars(), value.chars(), len);
+  setLength(len);
+  hash_.store(value.hash_.load(memory_order_relaxed), memory_order_relaxed);
   return *this;
 }
 
-String& String::operator= (char const* value)
+String& String::operator= (String&& value) noexcept
 {
-  ssize_t len = strlen(value);
-  if (len + 1 > (ssize_t)size_)
-  {
-    size_ = len + 1;
-    chars_ = unique_ptr<char[]>(new char[size_]);
-  }
-  length_ = len;
-  assert(length_ < size_);
-  memcpy(chars_.get(), value, len);
-  chars_[length_] = '\0';
+  if (&value == this)
+    return *this;
+  freeChars();
+  memcpy(inline_, value.inline_, sizeof(inline_));
+  alloc_ = value.alloc_;
+  hash_.store(value.hash_.load(memory_order_relaxed), memory_order_relaxed);
+  value.init(0);
   return *this;
 }
 
-String String::operator+(String const& value) const
+String& String::operator= (char const* value)
 {
-  return String(chars_.get(), length_, value.chars_.get(), value.length_);
+  size_t len = strlen(value);
+  if (isShared())
+    return *this = String(StringView(value, len), alloc_);
+  if (len > capacity())
+  {
+    freeChars();
+    init(len);
+  }
+  memmove(chars(), value, len);
+  setLength(len);
+  return *this;
 }
 
-String String::operator+(char const* value) const
+String& String::operator+= (String const& value)
 {
-  assert(value != nullptr);
-  return String(chars_.get(), length_, value, strlen(value));
+  size_t length = this->length();
+  size_t addLength = value.length();
+  reserve(length + addLength);
+  memcpy(chars() + length, value.chars(), addLength);
+  setLength(length + addLength);
+  return *this;
 }
 
-String String::operator+(char value) const
+String& String::operator+= (StringView value)
 {
-  return String(chars_.get(), length_, &value, 1);
-}
-      
-String& String::operator+= (String const& value)
-{
-  if (size_ < length_ + value.length_ + 1)
-  {
-    size_ = std::max<size_t>(size_ * 2, length_ + value.length_ + 1);
-    unique_ptr<char[]> newChars(new char[size_]);
-    if (chars_ != nullptr)
-    {
-      assert(size_ >= length_);
-      memcpy(newChars.get(), chars_.get(), length_);
-    }
-    chars_ = std::move(newChars);
-  }
-  assert(size_ > length_ + value.length_);
-  memcpy(chars_.get() + length_, value.chars_.get(), value.length_);
-  length_ += value.length_;
-  chars_[length_] = '\0';
+  appendChars(value.data(), value.length());
   return *this;
 }
 
 String& String::operator+= (char const* value)
 {
   assert(value != nullptr);
-  ssize_t addLength = strlen(value);
-  if (size_ < length_ + addLength + 1)
-  {
-    size_ = std::max<size_t>(size_ * 2, length_ + addLength + 1);
-    unique_ptr<char[]> newChars(new char[size_]);
-    if (chars_ != nullptr)
-    {
-      assert(size_ >= length_);
-      memcpy(newChars.get(), chars_.get(), length_);
-    }
-    chars_ = std::move(newChars);
-  }
-  assert(size_ > length_ + addLength);
-  memcpy(chars_.get() + length_, value, addLength);
-  length_ += addLength;
-  chars_[length_] = '\0';
+  appendChars(value, strlen(value));
   return *this;
 }
 
+void String::appendChars(char const* value, size_t addLength)
+{
+  size_t length = this->length();
+  // value may point into this string, which reserve can move or (when
+  // inline) overwrite, so find it again by offset afterwards
+  uintptr_t start = (uintptr_t)chars();
+  uintptr_t from = (uintptr_t)value;
+  bool inside = from >= start && from < start + length;
+  size_t offset = from - start;
+  reserve(length + addLength);
+  if (inside)
+    value = chars() + offset;
+  memmove(chars() + length, value, addLength);
+  setLength(length + addLength);
+}
+
 String& String::operator+= (char value)
 {
-  if (size_ < length_ + 2)
-  {
-    size_ = std::max<size_t>(size_ * 2, length_ + 2);
-    unique_ptr<char[]> newChars(new char[size_]);
-    if (chars_ != nullptr)
-    {
-      assert(size_ > length_);
-      memcpy(newChars.get(), chars_.get(), length_);
-    }
-    chars_ = std::move(newChars);
-  }
-  assert(size_ > length_ + 1);
-  chars_[length_++] = value;
-  chars_[length_] = '\0';
+  size_t length = this->length();
+  reserve(length + 1);
+  chars()[length] = value;
+  setLength(length + 1);
   return *this;
 }
 
 bool String::operator==(String const& other) const
 {
-  if (length_ != other.length_) 
-    return false;
-  for (off_t i = 0; i < (ssize_t)length_; i++)
-  {
-    if (chars_[i] != other.chars_[i])
-      return false;
-  }
-  return true;
+  return view() == other.view();
 }
 
 bool String::operator==(char const* other) const
 {
   if (other == nullptr) 
     return false;
-  ssize_t len = strlen(other);
-  if ((ssize_t)length_ != len) 
-    return false;
-  for (off_t i = 0; i < (ssize_t)length_; i++)
-  {
-    if (chars_[i] != other[i])
-      return false;
-  }
-  return true;
+  return view() == StringView(other);
+}
+
+bool String::operator==(StringView other) const
+{
+  return view() == other;
 }
 
 bool String::operator!=(String const& other) const
@@ -555,12 +498,180 @@ bool String::operator!=(char const* other) const
   return !(*this == other);
 }
 
+bool String::operator!=(StringView other) const
+{
+  return !(*this == other);
+}
+
 char String::operator[] (const off_t index) const
 {
-  assert(index < (ssize_t)length_);
-  assert(index >= -(ssize_t)length_);
+  ssize_t length = this->length();
+  assert(index < length);
+  assert(index >= -length);
   if (index < 0)
-    return chars_[length_ + index];
+    return chars()[length + index];
   else
-    return chars_[index];
+    return chars()[index];
+}
+
+namespace {
+  // The first chars are copied into the key, so the early passes, which
+  // look at every string, read them without a cache miss on the String
+  struct SortKey {
+    unsigned char prefix[8];
+    char const* chars;
+    size_t length;
+    size_t index;
+  };
+
+  // The char at depth as unsigned, or -1 past the end so that a prefix
+  // sorts before the strings it starts
+  inline int charAt(SortKey const& key, size_t depth)
+  {
+    if (depth >= key.length)
+      return -1;
+    if (depth < sizeof(key.prefix))
+      return key.prefix[depth];
+    return (unsigned char)key.chars[depth];
+  }
+
+  // Compares keys known to share their first depth chars
+  inline bool keyLess(SortKey const& a, SortKey const& b, size_t depth)
+  {
+    for (; depth < sizeof(a.prefix); depth++) {
+      int ca = charAt(a, depth);
+      int cb = charAt(b, depth);
+      if (ca != cb)
+        return ca < cb;
+      if (ca < 0)
+        return false;
+    }
+    return StringView(a.chars + depth, a.length - depth) <
+      StringView(b.chars + depth, b.length - depth);
+  }
+
+  // Multikey quicksort (Bentley and Sedgewick): three-way partitions on
+  // the char at depth, then sorts the equal part on the next char
+  void multikeySort(SortKey* keys, size_t count, size_t depth)
+  {
+    while (count > 1) {
+      if (count <= 16) {
+        for (size_t i = 1; i < count; i++) {
+          for (size_t j = i; j > 0 && keyLess(keys[j], keys[j - 1], depth); j--)
+            swap(keys[j], keys[j - 1]);
+        }
+        return;
+      }
+
+      int a = charAt(keys[0], depth);
+      int b = charAt(keys[count / 2], depth);
+      int c = charAt(keys[count - 1], depth);
+      int pivot = max(min(a, b), min(max(a, b), c));
+
+      size_t lt = 0;
+      size_t i = 0;
+      size_t gt = count;
+      while (i < gt) {
+        int ch = charAt(keys[i], depth);
+        if (ch < pivot)
+          swap(keys[lt++], keys[i++]);
+        else if (ch > pivot)
+          swap(keys[i], keys[--gt]);
+        else
+          i++;
+      }
+
+      multikeySort(keys, lt, depth);
+      multikeySort(keys + gt, count - gt, depth);
+      // Strings that ended at depth are all equal
+      if (pivot < 0)
+        return;
+      keys += lt;
+      count = gt - lt;
+      depth++;
+    }
+  }
+}
+
+namespace {
+  // Below this many keys a radix pass costs more than partitioning
+  static const size_t RadixCutoff = 1024;
+
+  // Most significant digit radix sort, a char per pass, handing small
+  // buckets to multikeySort. The largest bucket is sorted by looping
+  // rather than recursing, so the stack stays O(log n) deep.
+  void radixSortKeys(SortKey* keys, SortKey* scratch, size_t count, size_t depth)
+  {
+    while (count >= RadixCutoff) {
+      // Bucket 0 holds the strings that end before depth
+      size_t counts[257] = {0};
+      for (size_t i = 0; i < count; i++)
+        counts[charAt(keys[i], depth) + 1]++;
+
+      size_t largest = 0;
+      for (size_t b = 1; b < 257; b++) {
+        if (counts[b] > counts[largest])
+          largest = b;
+      }
+      if (counts[largest] == count) {
+        if (largest == 0)
+          return;
+        depth++;
+        continue;
+      }
+
+      size_t starts[257];
+      size_t offset = 0;
+      for (size_t b = 0; b < 257; b++) {
+        starts[b] = offset;
+        offset += counts[b];
+      }
+      size_t next[257];
+      memcpy(next, starts, sizeof(next));
+      for (size_t i = 0; i < count; i++)
+        scratch[next[charAt(keys[i], depth) + 1]++] = keys[i];
+      memcpy((void*)keys, (void*)scratch, sizeof(SortKey) * count);
+
+      for (size_t b = 1; b < 257; b++) {
+        if (b != largest && counts[b] > 1)
+          radixSortKeys(keys + starts[b], scratch, counts[b], depth + 1);
+      }
+      if (largest == 0)
+        return;
+      keys += starts[largest];
+      count = counts[largest];
+      depth++;
+    }
+    multikeySort(keys, count, depth);
+  }
+}
+
+// Sorts small keys pointing at the chars, then moves each String to its
+// place as bytes, which Relocatable<String> allows
+void DefaultSort<String>::sort(String* items, size_t count)
+{
+  if (count < SortImpl::RadixThreshold) {
+    sortRange(items, count, Less<String>());
+    return;
+  }
+  List<SortKey> keys(count);
+  for (size_t i = 0; i < count; i++) {
+    StringView value = items[i].view();
+    SortKey& key = keys.emplace();
+    size_t prefix = min(value.length(), sizeof(key.prefix));
+    if (prefix > 0)
+      memcpy(key.prefix, value.data(), prefix);
+    key.chars = value.data();
+    key.length = value.length();
+    key.index = i;
+  }
+  SortKey* scratch = (SortKey*)allocate(nullptr, sizeof(SortKey) * count);
+  radixSortKeys(&keys[0], scratch, count, 0);
+  release(nullptr, scratch, sizeof(SortKey) * count);
+
+  String* sorted = (String*)allocate(nullptr, sizeof(String) * count);
+  for (size_t i = 0; i < count; i++)
+    memcpy((void*)&sorted[i], (void*)&items[keys[i].index], sizeof(String));
+  memcpy((void*)items, (void*)sorted, sizeof(String) * count);
+  release(nullptr, sorted, sizeof(String) * count);
 }
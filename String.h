@@ -17,10 +17,16 @@
 #ifndef __Base_String_h
 #define __Base_String_h
 
+#include "Base/Allocator.h"
+#include "Base/Hash.h"
 #include "Base/List.h"
+#include "Base/StringView.h"
+#include "Base/Relocatable.h"
 #include "Base/compat/stdint.h"
 
+#include <atomic>
 #include <memory>
+#include <utility>
 
 namespace Base {
   class String;
@@ -31,80 +37,270 @@ namespace Base {
       virtual ~Stringable(){}
   };
 
-  String operator+(char const* lhs, String const& rhs);
-
   class String : public Stringable {
     public:
       String();
-      String(char const* value);
+      explicit String(Allocator* alloc);
+      String(char const* value, Allocator* alloc = nullptr);
+      explicit String(StringView value, Allocator* alloc = nullptr);
 
-      String(String const&);
+      String(String const& value, Allocator* alloc = nullptr);
+      String(String&&) noexcept;
       String& operator= (String const&);
+      String& operator= (String&&) noexcept;
+      ~String();
       String& operator= (char const*);
 
       String substring(off_t index) const;
       String substring(off_t index, size_t length) const;
 
+      StringView view() const { return StringView(chars(), length()); }
+      StringView view(off_t index) const { return view().substring(index); }
+      StringView view(off_t index, size_t length) const { return view().substring(index, length); }
+      operator StringView() const { return view(); }
+
       bool contains(String const& value) const;
       bool contains(char const* value) const;
+      bool contains(StringView value) const;
 
       String replace(char const* find, char const* replace) const;
       String replace(String const& find, String const& replace) const;
+      String replace(StringView find, StringView replace) const;
 
       String ltrim();
       String rtrim();
       String trim();
 
-      off_t indexOf(const char* str);
-      off_t indexOfR(const char* str);
-      off_t indexOf(String const& str) { return indexOf(str.c_str()); }
-      off_t indexOfR(String const& str) { return indexOfR(str.c_str()); }
+      off_t indexOf(const char* str) const;
+      off_t indexOfR(const char* str) const;
+      off_t indexOf(String const& str) const { return view().indexOf(str.view()); }
+      off_t indexOfR(String const& str) const { return view().indexOfR(str.view()); }
+      off_t indexOf(StringView str) const { return view().indexOf(str); }
+      off_t indexOfR(StringView str) const { return view().indexOfR(str); }
 
       List<String> split(char const* separator) const;
       List<String> split(String const& separator) const;
+      List<String> split(StringView separator) const;
 
       bool startsWith(char const* value) const;
       bool startsWith(String const& value) const;
+      bool startsWith(StringView value) const;
 
       bool endsWith(char const* value) const;
       bool endsWith(String const& value) const;
+      bool endsWith(StringView value) const;
 
       size_t length() const;
       char const* c_str() const;
       void copyTo(char* charBuffer) const;
       String toString() const override { return *this; }
 
-      int hash() const;
+      uint64_t hash() const;
 
-      String operator+(String const& value) const;
-      String operator+(char const* value) const;
-      String operator+(char value) const;
-      friend String operator+(char const* lhs, String const& rhs)
-      {
-	      return String(lhs, rhs.chars_.get(), rhs.length_);
-      }
+      Allocator* allocator() const { return alloc_; }
+
+      // Moves a heap string into a reference counted buffer so that copies
+      // (and copies of copies) share it in O(1) instead of duplicating the
+      // chars. The count is atomic, so shared copies may be handed to other
+      // threads. Writing to a shared string gives it a private copy first
+      // unless it is the last owner. Copies made with an explicit allocator
+      // still copy. Inline and arena-allocated strings are left as they are.
+      String& share();
+      bool isShared() const;
 
       String& operator+= (String const& value);
       String& operator+= (char const* value);
+      String& operator+= (StringView value);
       String& operator+= (char value);
 
+      // Joins any number of Strings, views, C strings and chars with a
+      // single allocation of the total length, e.g. for a + " " + b + '!'
+      // without an intermediate String per +
+      template <typename... Pieces>
+      static String concat(Pieces const&... pieces);
+
       bool operator==(String const& other) const;
       bool operator==(char const* other) const;
+      bool operator==(StringView other) const;
       bool operator!=(String const& other) const;
       bool operator!=(char const* other) const;
+      bool operator!=(StringView other) const;
+
+      // Byte order, as StringView::compare
+      int compare(StringView other) const { return view().compare(other); }
+      bool operator<(String const& other) const { return compare(other) < 0; }
+      bool operator<=(String const& other) const { return compare(other) <= 0; }
+      bool operator>(String const& other) const { return compare(other) > 0; }
+      bool operator>=(String const& other) const { return compare(other) >= 0; }
 
       char operator[] (const off_t index) const;
 
     private:
-      std::unique_ptr<char[]> chars_;
-      size_t length_;
-      size_t size_;
+      // Strings of up to InlineCapacity chars live in inline_, the last byte
+      // of which holds the unused inline capacity (so it doubles as the
+      // terminator when full). Longer strings live in heap_, whose size field
+      // carries HeapFlag in both its first and last byte so the mode can be
+      // read from inline_[InlineCapacity] regardless of byte order.
+      static constexpr size_t InlineCapacity = 23;
+      static constexpr size_t HeapFlag = 0x80 | ((size_t)0x80 << (sizeof(size_t) * 8 - 8));
+      // Set in heap_.size when heap_.chars follows a SharedHeader
+      static constexpr size_t SharedFlag = 0x40;
+
+      union {
+        struct {
+          char* chars;
+          size_t length;
+          size_t size;
+        } heap_;
+        char inline_[InlineCapacity + 1];
+      };
+      Allocator* alloc_;
+      // Memoized hash(), 0 until computed. Reset whenever the chars change.
+      mutable std::atomic<uint64_t> hash_;
+
+      bool isInline() const
+      {
+        return (static_cast<unsigned char>(inline_[InlineCapacity]) & 0x80) == 0;
+      }
+
+      char* chars()
+      {
+        return isInline() ? inline_ : heap_.chars;
+      }
+
+      char const* chars() const
+      {
+        return isInline() ? inline_ : heap_.chars;
+      }
+
+      size_t capacity() const;
+      void setLength(size_t length);
+      char* init(size_t length);
+      void reserve(size_t capacity);
+      void appendChars(char const* value, size_t length);
+      void freeChars();
+
+      struct SharedHeader;
+      SharedHeader* sharedHeader() const;
+      void adopt(String const& value);
 
-      String(char const* inner1, size_t len1, char const* inner2, size_t len2);
-      String(char const* inner1, char const* inner2, size_t len2);
       String(char const* inner1, size_t len1);
 
-      bool partEq(char const* inner, char const* test, size_t testLen) const;
+      static size_t pieceLength(StringView value) { return value.length(); }
+      static size_t pieceLength(char) { return 1; }
+      static char* writePiece(char* out, StringView value)
+      {
+        memcpy(out, value.data(), value.length());
+        return out + value.length();
+      }
+      static char* writePiece(char* out, char value)
+      {
+        *out = value;
+        return out + 1;
+      }
+
+      static size_t concatLength() { return 0; }
+      template <typename P, typename... Pieces>
+      static size_t concatLength(P const& piece, Pieces const&... pieces)
+      {
+        return pieceLength(piece) + concatLength(pieces...);
+      }
+
+      static void concatWrite(char*) {}
+      template <typename P, typename... Pieces>
+      static void concatWrite(char* out, P const& piece, Pieces const&... pieces)
+      {
+        concatWrite(writePiece(out, piece), pieces...);
+      }
+  };
+
+  template <typename... Pieces>
+  String String::concat(Pieces const&... pieces)
+  {
+    String ret;
+    concatWrite(ret.init(concatLength(pieces...)), pieces...);
+    return ret;
+  }
+
+  // Both sides are written into one exact-size allocation. A temporary left
+  // side (as in a chain like a + b + c) is appended to in place instead.
+  inline String operator+(String const& lhs, StringView rhs)
+  {
+    return String::concat(lhs, rhs);
+  }
+
+  inline String operator+(String const& lhs, String const& rhs)
+  {
+    return String::concat(lhs, rhs);
+  }
+
+  inline String operator+(String const& lhs, char const* rhs)
+  {
+    return String::concat(lhs, rhs);
+  }
+
+  inline String operator+(String const& lhs, char rhs)
+  {
+    return String::concat(lhs, rhs);
+  }
+
+  inline String operator+(StringView lhs, String const& rhs)
+  {
+    return String::concat(lhs, rhs);
+  }
+
+  inline String operator+(char const* lhs, String const& rhs)
+  {
+    return String::concat(lhs, rhs);
+  }
+
+  inline String operator+(String&& lhs, StringView rhs)
+  {
+    lhs += rhs;
+    return std::move(lhs);
+  }
+
+  inline String operator+(String&& lhs, String const& rhs)
+  {
+    lhs += rhs.view();
+    return std::move(lhs);
+  }
+
+  inline String operator+(String&& lhs, char const* rhs)
+  {
+    lhs += rhs;
+    return std::move(lhs);
+  }
+
+  inline String operator+(String&& lhs, char rhs)
+  {
+    lhs += rhs;
+    return std::move(lhs);
+  }
+
+  // Inline characters are addressed through this, never through a stored
+  // pointer, and the hash cache is a lock-free word, so a String may be
+  // moved by copying its bytes
+  template <>
+  struct Relocatable<String> : std::true_type {};
+
+  // A String hashes its bytes exactly as a StringView does, so String
+  // tables are searched by view (and so by char const*) without a copy
+  template <>
+  struct LookupKey<String> {
+    typedef StringView type;
+  };
+
+  // Sorts with multikey quicksort, which looks at each char about once
+  // instead of comparing whole strings
+  template <>
+  struct DefaultSort<String> {
+    static void sort(String* items, size_t count);
+
+    static void stableSort(String* items, size_t count)
+    {
+      stableSortRange(items, count, Less<String>());
+    }
   };
 }
 
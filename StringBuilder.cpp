@@ -0,0 +1,121 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/StringBuilder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace Base;
+
+StringBuilder::StringBuilder(Allocator* alloc) :
+  chars_(inline_),
+  length_(0),
+  capacity_(InlineCapacity),
+  alloc_(alloc)
+{}
+
+StringBuilder::StringBuilder(size_t capacity, Allocator* alloc) :
+  chars_(inline_),
+  length_(0),
+  capacity_(InlineCapacity),
+  alloc_(alloc)
+{
+  reserve(capacity);
+}
+
+StringBuilder::~StringBuilder()
+{
+  if (chars_ != inline_)
+    release(alloc_, chars_, capacity_);
+}
+
+void StringBuilder::reserve(size_t capacity)
+{
+  if (capacity <= capacity_)
+    return;
+  if (chars_ == inline_) {
+    char* chars = (char*)allocate(alloc_, capacity);
+    memcpy(chars, inline_, length_);
+    chars_ = chars;
+  } else {
+    chars_ = (char*)reallocate(alloc_, chars_, capacity_, capacity);
+  }
+  capacity_ = capacity;
+}
+
+char* StringBuilder::grow(size_t length)
+{
+  if (length_ + length > capacity_)
+    reserve(std::max(capacity_ * 2, length_ + length));
+  char* ret = chars_ + length_;
+  length_ += length;
+  return ret;
+}
+
+StringBuilder& StringBuilder::append(char value)
+{
+  *grow(1) = value;
+  return *this;
+}
+
+StringBuilder& StringBuilder::append(char const* value)
+{
+  return append(StringView(value));
+}
+
+StringBuilder& StringBuilder::append(StringView value)
+{
+  memcpy(grow(value.length()), value.data(), value.length());
+  return *this;
+}
+
+StringBuilder& StringBuilder::append(unsigned long long value)
+{
+  char digits[20];
+  char* p = digits + sizeof(digits);
+  do {
+    *--p = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  return append(StringView(p, digits + sizeof(digits) - p));
+}
+
+StringBuilder& StringBuilder::append(long long value)
+{
+  if (value < 0) {
+    append('-');
+    return append(0ull - (unsigned long long)value);
+  }
+  return append((unsigned long long)value);
+}
+
+StringBuilder& StringBuilder::append(double value)
+{
+  // Shortest of 15 or 17 significant digits that reads back exactly
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "%.15g", value);
+  if (strtod(buf, nullptr) != value)
+    len = snprintf(buf, sizeof(buf), "%.17g", value);
+  return append(StringView(buf, len));
+}
+
+String StringBuilder::toString(Allocator* alloc) const
+{
+  return String(view(), alloc != nullptr ? alloc : alloc_);
+}
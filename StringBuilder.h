@@ -0,0 +1,79 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_StringBuilder_h
+#define __Base_StringBuilder_h
+
+#include "Base/Allocator.h"
+#include "Base/String.h"
+#include "Base/StringView.h"
+
+namespace Base
+{
+  // Accumulates pieces into a buffer that doubles as it fills (starting in
+  // an inline buffer, so short results never touch the heap until the end)
+  // and produces the String with one allocation of the exact length.
+  class StringBuilder {
+    public:
+      StringBuilder(Allocator* alloc = nullptr);
+      StringBuilder(size_t capacity, Allocator* alloc = nullptr);
+      StringBuilder(StringBuilder const&) = delete;
+      StringBuilder& operator= (StringBuilder const&) = delete;
+      ~StringBuilder();
+
+      StringBuilder& append(char value);
+      StringBuilder& append(char const* value);
+      StringBuilder& append(StringView value);
+      StringBuilder& append(String const& value) { return append(value.view()); }
+      StringBuilder& append(Stringable const& value) { return append(value.toString()); }
+      StringBuilder& append(int value) { return append((long long)value); }
+      StringBuilder& append(unsigned value) { return append((unsigned long long)value); }
+      StringBuilder& append(long value) { return append((long long)value); }
+      StringBuilder& append(unsigned long value) { return append((unsigned long long)value); }
+      StringBuilder& append(long long value);
+      StringBuilder& append(unsigned long long value);
+      StringBuilder& append(double value);
+
+      template <typename T>
+      StringBuilder& operator<< (T const& value)
+      {
+        return append(value);
+      }
+
+      void reserve(size_t capacity);
+      void clear() { length_ = 0; }
+
+      size_t length() const { return length_; }
+      StringView view() const { return StringView(chars_, length_); }
+
+      // The result uses alloc when given, otherwise the builder's allocator
+      String toString(Allocator* alloc = nullptr) const;
+
+    private:
+      static constexpr size_t InlineCapacity = 256;
+
+      char* chars_;
+      size_t length_;
+      size_t capacity_;
+      Allocator* alloc_;
+      char inline_[InlineCapacity];
+
+      // Makes room for length more chars and returns where they go
+      char* grow(size_t length);
+  };
+}
+
+#endif
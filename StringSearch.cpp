@@ -0,0 +1,348 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/StringSearch.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  #define BASE_SEARCH_X86
+  #include <immintrin.h>
+#endif
+
+using namespace Base;
+
+typedef unsigned char uchar;
+typedef off_t (*FindFn)(uchar const*, size_t, uchar const*, size_t);
+typedef uint64_t (*CharMaskFn)(uchar const*, uchar);
+
+// Needles longer than this hand over to Two-Way once the first/last byte
+// filter produces more than one false candidate per MissRatio bytes.
+static const size_t LongNeedle = 32;
+static const size_t MissRatio = 16;
+
+static bool tooManyMisses(size_t needleLength, size_t misses, size_t scanned)
+{
+  return needleLength > LongNeedle && misses * MissRatio > scanned + 256;
+}
+
+static off_t twoWayFrom(uchar const* h, size_t length, size_t start, uchar const* n, size_t m)
+{
+  off_t found = StringSearch::findTwoWay((char const*)h + start, length - start, (char const*)n, m);
+  return found < 0 ? -1 : (off_t)start + found;
+}
+
+static size_t maxSuffix(uchar const* n, size_t m, size_t& period, bool greater)
+{
+  size_t ip = (size_t)-1;
+  size_t jp = 0;
+  size_t k = 1;
+  size_t p = 1;
+  while (jp + k < m) {
+    uchar a = n[ip + k];
+    uchar b = n[jp + k];
+    if (a == b) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else {
+        k++;
+      }
+    } else if (greater ? a > b : a < b) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  period = p;
+  return ip;
+}
+
+// For haystacks with too few positions to fill a vector block, where the
+// setup of the vector and memchr paths would cost more than the search
+static off_t findShort(uchar const* h, size_t length, uchar const* n, size_t m)
+{
+  uchar first = n[0];
+  uchar last = n[m - 1];
+  for (size_t i = 0; i + m <= length; i++) {
+    if (h[i] == first && h[i + m - 1] == last && memcmp(h + i + 1, n + 1, m - 2) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static off_t findFiltered(uchar const* h, size_t length, uchar const* n, size_t m)
+{
+  if (length < m)
+    return -1;
+  uchar const* end = h + length - m + 1;
+  size_t misses = 0;
+  for (uchar const* p = h; p < end; p++) {
+    p = (uchar const*)memchr(p, n[0], end - p);
+    if (p == nullptr)
+      return -1;
+    if (p[m - 1] == n[m - 1] && memcmp(p + 1, n + 1, m - 2) == 0)
+      return p - h;
+    if (tooManyMisses(m, ++misses, p - h))
+      return twoWayFrom(h, length, p - h + 1, n, m);
+  }
+  return -1;
+}
+
+#ifdef BASE_SEARCH_X86
+static off_t findSse2(uchar const* h, size_t length, uchar const* n, size_t m)
+{
+  // Positions are 0 .. length - m; the last block is moved back to end
+  // exactly there, with the positions it repeats masked off
+  size_t positions = length - m + 1;
+  if (positions < 16)
+    return findShort(h, length, n, m);
+  __m128i first = _mm_set1_epi8(n[0]);
+  __m128i last = _mm_set1_epi8(n[m - 1]);
+  size_t misses = 0;
+  for (size_t i = 0; i < positions; i += 16) {
+    unsigned skip = 0;
+    if (i + 16 > positions) {
+      skip = i - (positions - 16);
+      i = positions - 16;
+    }
+    __m128i blockFirst = _mm_loadu_si128((__m128i const*)(h + i));
+    __m128i blockLast = _mm_loadu_si128((__m128i const*)(h + i + m - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(first, blockFirst),
+      _mm_cmpeq_epi8(last, blockLast)));
+    mask &= ~0u << skip;
+    while (mask != 0) {
+      size_t pos = i + __builtin_ctz(mask);
+      if (memcmp(h + pos + 1, n + 1, m - 2) == 0)
+        return pos;
+      if (tooManyMisses(m, ++misses, pos))
+        return twoWayFrom(h, length, pos + 1, n, m);
+      mask &= mask - 1;
+    }
+  }
+  return -1;
+}
+
+__attribute__((target("avx2")))
+static off_t findAvx2(uchar const* h, size_t length, uchar const* n, size_t m)
+{
+  size_t positions = length - m + 1;
+  if (positions < 32)
+    return findSse2(h, length, n, m);
+  __m256i first = _mm256_set1_epi8(n[0]);
+  __m256i last = _mm256_set1_epi8(n[m - 1]);
+  size_t misses = 0;
+  for (size_t i = 0; i < positions; i += 32) {
+    unsigned skip = 0;
+    if (i + 32 > positions) {
+      skip = i - (positions - 32);
+      i = positions - 32;
+    }
+    __m256i blockFirst = _mm256_loadu_si256((__m256i const*)(h + i));
+    __m256i blockLast = _mm256_loadu_si256((__m256i const*)(h + i + m - 1));
+    unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+      _mm256_cmpeq_epi8(first, blockFirst),
+      _mm256_cmpeq_epi8(last, blockLast)));
+    mask &= (unsigned)(~0ull << skip);
+    while (mask != 0) {
+      size_t pos = i + __builtin_ctz(mask);
+      if (memcmp(h + pos + 1, n + 1, m - 2) == 0)
+        return pos;
+      if (tooManyMisses(m, ++misses, pos))
+        return twoWayFrom(h, length, pos + 1, n, m);
+      mask &= mask - 1;
+    }
+  }
+  return -1;
+}
+#endif
+
+static FindFn findImpl()
+{
+#ifdef BASE_SEARCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return findAvx2;
+  return findSse2;
+#else
+  return findFiltered;
+#endif
+}
+
+#ifndef BASE_SEARCH_X86
+static uint64_t charMaskScalar(uchar const* block, uchar c)
+{
+  uint64_t mask = 0;
+  for (size_t i = 0; i < 64; i++)
+    mask |= (uint64_t)(block[i] == c) << i;
+  return mask;
+}
+#else
+static uint64_t charMaskSse2(uchar const* block, uchar c)
+{
+  __m128i needle = _mm_set1_epi8(c);
+  uint64_t mask = 0;
+  for (size_t i = 0; i < 64; i += 16) {
+    __m128i chunk = _mm_loadu_si128((__m128i const*)(block + i));
+    mask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)) << i;
+  }
+  return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t charMaskAvx2(uchar const* block, uchar c)
+{
+  __m256i needle = _mm256_set1_epi8(c);
+  __m256i low = _mm256_loadu_si256((__m256i const*)block);
+  __m256i high = _mm256_loadu_si256((__m256i const*)(block + 32));
+  uint64_t lowMask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle));
+  uint64_t highMask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle));
+  return lowMask | highMask << 32;
+}
+#endif
+
+static CharMaskFn charMaskImpl()
+{
+#ifdef BASE_SEARCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return charMaskAvx2;
+  return charMaskSse2;
+#else
+  return charMaskScalar;
+#endif
+}
+
+uint64_t StringSearch::charMask(char const* block, char c)
+{
+  static CharMaskFn const impl = charMaskImpl();
+  return impl((uchar const*)block, (uchar)c);
+}
+
+off_t StringSearch::find(char const* haystack, size_t length,
+                         char const* needle, size_t needleLength)
+{
+  if (needleLength == 0)
+    return 0;
+  if (needleLength > length)
+    return -1;
+  if (needleLength == 1) {
+    void const* found = memchr(haystack, needle[0], length);
+    return found == nullptr ? -1 : (char const*)found - haystack;
+  }
+  if (length - needleLength + 1 < 16)
+    return findShort((uchar const*)haystack, length, (uchar const*)needle, needleLength);
+  static FindFn const impl = findImpl();
+  return impl((uchar const*)haystack, length, (uchar const*)needle, needleLength);
+}
+
+off_t StringSearch::findScalar(char const* haystack, size_t length,
+                               char const* needle, size_t needleLength)
+{
+  if (needleLength == 0)
+    return 0;
+  if (needleLength > length)
+    return -1;
+  if (needleLength == 1) {
+    void const* found = memchr(haystack, needle[0], length);
+    return found == nullptr ? -1 : (char const*)found - haystack;
+  }
+  return findFiltered((uchar const*)haystack, length, (uchar const*)needle, needleLength);
+}
+
+off_t StringSearch::findR(char const* haystack, size_t length,
+                          char const* needle, size_t needleLength)
+{
+  if (needleLength == 0 || needleLength > length)
+    return -1;
+  char first = needle[0];
+  char last = needle[needleLength - 1];
+  for (off_t i = length - needleLength; i >= 0; i--) {
+    if (haystack[i] == first && haystack[i + needleLength - 1] == last &&
+        memcmp(haystack + i, needle, needleLength) == 0)
+      return i;
+  }
+  return -1;
+}
+
+off_t StringSearch::findTwoWay(char const* haystack, size_t length,
+                               char const* needle, size_t needleLength)
+{
+  uchar const* h = (uchar const*)haystack;
+  uchar const* n = (uchar const*)needle;
+  size_t m = needleLength;
+  if (m == 0)
+    return 0;
+  if (m > length)
+    return -1;
+
+  size_t period;
+  size_t otherPeriod;
+  size_t split = maxSuffix(n, m, period, true);
+  size_t otherSplit = maxSuffix(n, m, otherPeriod, false);
+  if (otherSplit + 1 > split + 1) {
+    split = otherSplit;
+    period = otherPeriod;
+  }
+
+  size_t memoryAfterShift;
+  if (memcmp(n, n + period, split + 1) != 0) {
+    memoryAfterShift = 0;
+    period = std::max(split, m - split - 1) + 1;
+  } else {
+    memoryAfterShift = m - period;
+  }
+
+  size_t shift[256] = {0};
+  for (size_t i = 0; i < m; i++)
+    shift[n[i]] = i + 1;
+
+  size_t memory = 0;
+  size_t pos = 0;
+  while (length - pos >= m) {
+    size_t k = shift[h[pos + m - 1]];
+    if (k == 0) {
+      pos += m;
+      memory = 0;
+      continue;
+    }
+    k = m - k;
+    if (k != 0) {
+      if (memory != 0 && k < period)
+        k = m - period;
+      pos += k;
+      memory = 0;
+      continue;
+    }
+    for (k = std::max(split + 1, memory); k < m && n[k] == h[pos + k]; k++);
+    if (k < m) {
+      pos += k - split;
+      memory = 0;
+      continue;
+    }
+    for (k = split + 1; k > memory && n[k - 1] == h[pos + k - 1]; k--);
+    if (k <= memory)
+      return pos;
+    pos += period;
+    memory = memoryAfterShift;
+  }
+  return -1;
+}
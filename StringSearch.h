@@ -0,0 +1,48 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_StringSearch_h
+#define __Base_StringSearch_h
+
+#include "Base/compat/stdint.h"
+
+#include <sys/types.h>
+
+namespace Base
+{
+  // Substring search shared by String and StringView. find() filters
+  // candidates on the needle's first and last byte (AVX2 or SSE2, picked
+  // at runtime, with a scalar fallback) and switches to Two-Way when the
+  // filter stops paying off, so the worst case stays linear.
+  class StringSearch {
+    public:
+      static off_t find(char const* haystack, size_t length,
+                        char const* needle, size_t needleLength);
+      static off_t findR(char const* haystack, size_t length,
+                         char const* needle, size_t needleLength);
+
+      static off_t findTwoWay(char const* haystack, size_t length,
+                              char const* needle, size_t needleLength);
+      static off_t findScalar(char const* haystack, size_t length,
+                              char const* needle, size_t needleLength);
+
+      // Bit i is set when block[i] == c, over the 64 bytes at block. Lets a
+      // scanner find every match in a block with one vector pass.
+      static uint64_t charMask(char const* block, char c);
+  };
+}
+
+#endif
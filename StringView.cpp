@@ -0,0 +1,94 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/Char.h"
+#include "Base/Hash.h"
+#include "Base/String.h"
+#include "Base/StringSearch.h"
+#include "Base/StringView.h"
+
+using namespace Base;
+
+StringView StringView::ltrim() const
+{
+  size_t i = 0;
+  while (i < length_ && Char::isWhitespace(chars_[i]))
+    i++;
+  return StringView(chars_ + i, length_ - i);
+}
+
+StringView StringView::rtrim() const
+{
+  size_t len = length_;
+  while (len > 0 && Char::isWhitespace(chars_[len - 1]))
+    len--;
+  return StringView(chars_, len);
+}
+
+StringView StringView::trim() const
+{
+  return ltrim().rtrim();
+}
+
+bool StringView::contains(StringView value) const
+{
+  return indexOf(value) >= 0;
+}
+
+off_t StringView::indexOf(StringView value) const
+{
+  return StringSearch::find(chars_, length_, value.chars_, value.length_);
+}
+
+off_t StringView::indexOfR(StringView value) const
+{
+  return StringSearch::findR(chars_, length_, value.chars_, value.length_);
+}
+
+String StringView::toString() const
+{
+  return String(*this);
+}
+
+uint64_t StringView::hash() const
+{
+  return Hash::bytes(chars_, length_);
+}
+
+void StringLineIter::findEnd()
+{
+  size_t length = value_.length();
+  for (;;) {
+    if (mask_ != 0) {
+      end_ = block_ + __builtin_ctzll(mask_);
+      mask_ &= mask_ - 1;
+      return;
+    }
+    block_ += 64;
+    if ((size_t)block_ >= length) {
+      end_ = length;
+      return;
+    }
+    if (block_ + 64 <= (off_t)length) {
+      mask_ = StringSearch::charMask(value_.data() + block_, '\n');
+    } else {
+      // Never read past the end, even within the page
+      char tail[64] = {0};
+      memcpy(tail, value_.data() + block_, length - block_);
+      mask_ = StringSearch::charMask(tail, '\n') & (((uint64_t)1 << (length - block_)) - 1);
+    }
+  }
+}
@@ -0,0 +1,266 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_StringView_h
+#define __Base_StringView_h
+
+#include "Base/compat/stdint.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace Base {
+  class String;
+  class StringSplitIter;
+  class StringLineIter;
+
+  // Non-owning (pointer, length) reference to chars held elsewhere. Views
+  // are not null terminated and are only valid while the chars they point
+  // into are.
+  class StringView {
+    public:
+      StringView() :
+        chars_(""),
+        length_(0)
+      {}
+
+      StringView(char const* value) :
+        chars_(value),
+        length_(strlen(value))
+      {
+        assert(value != nullptr);
+      }
+
+      StringView(char const* value, size_t length) :
+        chars_(value),
+        length_(length)
+      {
+        assert(value != nullptr || length == 0);
+      }
+
+      StringView substring(off_t index) const
+      {
+        assert(index <= (ssize_t)length_);
+        return StringView(chars_ + index, length_ - index);
+      }
+
+      StringView substring(off_t index, size_t length) const
+      {
+        assert(index <= (ssize_t)length_);
+        assert(index + (ssize_t)length <= (ssize_t)length_);
+        return StringView(chars_ + index, length);
+      }
+
+      StringView ltrim() const;
+      StringView rtrim() const;
+      StringView trim() const;
+
+      bool contains(StringView value) const;
+      off_t indexOf(StringView value) const;
+      off_t indexOfR(StringView value) const;
+
+      StringSplitIter split(StringView separator) const;
+      // Lines without their "\n" or "\r\n"; unlike split, a final newline
+      // does not produce an empty last line
+      StringLineIter lines() const;
+
+      bool startsWith(StringView value) const
+      {
+        return value.length_ <= length_ &&
+          memcmp(chars_, value.chars_, value.length_) == 0;
+      }
+
+      bool endsWith(StringView value) const
+      {
+        return value.length_ <= length_ &&
+          memcmp(chars_ + length_ - value.length_, value.chars_, value.length_) == 0;
+      }
+
+      size_t length() const
+      {
+        return length_;
+      }
+
+      char const* data() const
+      {
+        return chars_;
+      }
+
+      void copyTo(char* charBuffer) const
+      {
+        memcpy(charBuffer, chars_, length_);
+        charBuffer[length_] = '\0';
+      }
+
+      String toString() const;
+
+      uint64_t hash() const;
+
+      bool operator==(StringView other) const
+      {
+        return length_ == other.length_ &&
+          memcmp(chars_, other.chars_, length_) == 0;
+      }
+
+      bool operator!=(StringView other) const
+      {
+        return !(*this == other);
+      }
+
+      // Orders by unsigned bytes, a prefix before the longer string;
+      // returns <0, 0 or >0
+      int compare(StringView other) const
+      {
+        size_t common = length_ < other.length_ ? length_ : other.length_;
+        int ret = common == 0 ? 0 : memcmp(chars_, other.chars_, common);
+        if (ret != 0)
+          return ret;
+        return length_ < other.length_ ? -1 : length_ > other.length_ ? 1 : 0;
+      }
+
+      bool operator<(StringView other) const { return compare(other) < 0; }
+      bool operator<=(StringView other) const { return compare(other) <= 0; }
+      bool operator>(StringView other) const { return compare(other) > 0; }
+      bool operator>=(StringView other) const { return compare(other) >= 0; }
+
+      char operator[] (const off_t index) const
+      {
+        assert(index < (ssize_t)length_);
+        assert(index >= -(ssize_t)length_);
+        if (index < 0)
+          return chars_[length_ + index];
+        else
+          return chars_[index];
+      }
+
+    private:
+      char const* chars_;
+      size_t length_;
+  };
+
+  class StringSplitIter {
+    public:
+      StringSplitIter(StringView value, StringView separator) :
+        value_(value),
+        separator_(separator),
+        start_(0),
+        end_(0),
+        valid_(true)
+      {
+        assert(separator_.length() > 0);
+        findEnd();
+      }
+
+      bool valid() const {
+        return valid_;
+      }
+
+      StringView value() const {
+        assert(valid_);
+        return value_.substring(start_, end_ - start_);
+      }
+
+      void next() {
+        if (end_ == (ssize_t)value_.length()) {
+          valid_ = false;
+          return;
+        }
+        start_ = end_ + separator_.length();
+        findEnd();
+      }
+
+    private:
+      StringView value_;
+      StringView separator_;
+      off_t start_;
+      off_t end_;
+      bool valid_;
+
+      void findEnd() {
+        off_t index = value_.substring(start_).indexOf(separator_);
+        end_ = index < 0 ? value_.length() : start_ + index;
+      }
+  };
+
+  inline StringSplitIter StringView::split(StringView separator) const
+  {
+    return StringSplitIter(*this, separator);
+  }
+
+  // Finds newlines 64 bytes at a time with StringSearch::charMask and
+  // hands them out from the resulting bitmask, so short lines cost a few
+  // bit operations rather than a search call each.
+  class StringLineIter {
+    public:
+      StringLineIter(StringView value) :
+        value_(value),
+        start_(0),
+        end_(0),
+        block_(-64),
+        mask_(0),
+        valid_(value.length() > 0)
+      {
+        if (valid_)
+          findEnd();
+      }
+
+      bool valid() const {
+        return valid_;
+      }
+
+      StringView value() const {
+        assert(valid_);
+        size_t length = end_ - start_;
+        if (length > 0 && value_.data()[end_ - 1] == '\r')
+          length--;
+        return StringView(value_.data() + start_, length);
+      }
+
+      // Offset of the current line in the whole value
+      size_t offset() const {
+        return start_;
+      }
+
+      void next() {
+        if (!valid_)
+          return;
+        start_ = end_ + 1;
+        if (start_ >= value_.length()) {
+          valid_ = false;
+          return;
+        }
+        findEnd();
+      }
+
+    private:
+      StringView value_;
+      size_t start_;
+      size_t end_;
+      // Newlines not yet handed out in the 64 bytes at block_
+      off_t block_;
+      uint64_t mask_;
+      bool valid_;
+
+      void findEnd();
+  };
+
+  inline StringLineIter StringView::lines() const
+  {
+    return StringLineIter(*this);
+  }
+}
+
+#endif
@@ -0,0 +1,389 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/ThreadPool.h"
+#include "Base/List.h"
+#include "Base/Queue.h"
+#include "Base/compat/sizes.h"
+
+#include <algorithm>
+
+using namespace Base;
+
+// Chase-Lev work stealing deque (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). Only the owning worker pushes
+// and pops, at the bottom; any thread may steal from the top. Arrays
+// replaced while growing are kept until the deque is destroyed, since a
+// thief may still be reading one.
+class ThreadPool::Deque {
+  public:
+    Deque() :
+      top_(0),
+      bottom_(0),
+      array_(new Array(64))
+    {}
+
+    ~Deque()
+    {
+      delete array_.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < retired_.count(); i++)
+        delete retired_[i];
+    }
+
+    void push(Task* task)
+    {
+      int64_t bottom = bottom_.load(std::memory_order_relaxed);
+      int64_t top = top_.load(std::memory_order_acquire);
+      Array* array = array_.load(std::memory_order_relaxed);
+      if (bottom - top > (int64_t)array->mask)
+        array = grow(array, top, bottom);
+      array->put(bottom, task);
+      bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    Task* pop()
+    {
+      int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+      Array* array = array_.load(std::memory_order_relaxed);
+      bottom_.store(bottom, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t top = top_.load(std::memory_order_relaxed);
+      if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      Task* task = array->get(bottom);
+      if (top == bottom) {
+        // Last item: race any thief for it
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+          task = nullptr;
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+      }
+      return task;
+    }
+
+    // Returns nullptr when empty or when another thread won the race
+    Task* steal()
+    {
+      int64_t top = top_.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t bottom = bottom_.load(std::memory_order_acquire);
+      if (top >= bottom)
+        return nullptr;
+      Task* task = array_.load(std::memory_order_acquire)->get(top);
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed))
+        return nullptr;
+      return task;
+    }
+
+  private:
+    struct Array {
+      size_t mask;
+      std::atomic<Task*>* items;
+
+      Array(size_t size) :
+        mask(size - 1),
+        items(new std::atomic<Task*>[size])
+      {}
+
+      ~Array()
+      {
+        delete[] items;
+      }
+
+      Task* get(int64_t i) const
+      {
+        return items[i & mask].load(std::memory_order_relaxed);
+      }
+
+      void put(int64_t i, Task* task)
+      {
+        items[i & mask].store(task, std::memory_order_relaxed);
+      }
+    };
+
+    // Thieves write top_ and the owner writes bottom_; keep them apart
+    std::atomic<int64_t> top_;
+    char pad_[SZ_CACHE_LINE];
+    std::atomic<int64_t> bottom_;
+    std::atomic<Array*> array_;
+    List<Array*> retired_;
+
+    Array* grow(Array* array, int64_t top, int64_t bottom)
+    {
+      Array* bigger = new Array((array->mask + 1) * 2);
+      for (int64_t i = top; i < bottom; i++)
+        bigger->put(i, array->get(i));
+      array_.store(bigger, std::memory_order_release);
+      retired_.add(array);
+      return bigger;
+    }
+};
+
+// Tasks spawned by threads outside the pool
+class ThreadPool::Injector {
+  public:
+    void push(Task* task)
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      queue_.enqueue(task);
+      count_.store(queue_.count(), std::memory_order_relaxed);
+    }
+
+    Task* pop()
+    {
+      if (count_.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+      std::lock_guard<std::mutex> guard(lock_);
+      if (queue_.count() == 0)
+        return nullptr;
+      Task* task = queue_.dequeue();
+      count_.store(queue_.count(), std::memory_order_relaxed);
+      return task;
+    }
+
+  private:
+    std::mutex lock_;
+    Queue<Task*> queue_;
+    // Lets idle threads skip the lock while nothing is queued
+    std::atomic<size_t> count_{0};
+};
+
+struct ThreadPool::Worker {
+  ThreadPool* pool;
+  Deque deque;
+  std::thread thread;
+  // Picks where to start looking for a victim
+  uint64_t random;
+};
+
+namespace {
+  thread_local void* currentWorkerSlot = nullptr;
+}
+
+ThreadPool::ThreadPool(size_t threads) :
+  threadCount_(threads),
+  workers_(nullptr),
+  injector_(new Injector()),
+  stopping_(false),
+  signal_(0),
+  sleepers_(0)
+{
+  if (threadCount_ == 0)
+    threadCount_ = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  workers_ = new Worker[threadCount_];
+  for (size_t i = 0; i < threadCount_; i++) {
+    workers_[i].pool = this;
+    workers_[i].random = 0x9e3779b97f4a7c15ull * (i + 1);
+  }
+  for (size_t i = 0; i < threadCount_; i++) {
+    Worker* worker = &workers_[i];
+    worker->thread = std::thread([this, worker]() { workerMain(worker); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(sleepLock_);
+    stopping_.store(true);
+    signal_.fetch_add(1);
+  }
+  sleepCond_.notify_all();
+  for (size_t i = 0; i < threadCount_; i++)
+    workers_[i].thread.join();
+  delete[] workers_;
+  delete injector_;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+  // Never destroyed, so tasks may still run during static destruction
+  static ThreadPool* pool = new ThreadPool();
+  return *pool;
+}
+
+ThreadPool::Worker* ThreadPool::currentWorker() const
+{
+  Worker* worker = (Worker*)currentWorkerSlot;
+  if (worker == nullptr || worker->pool != this)
+    return nullptr;
+  return worker;
+}
+
+void ThreadPool::push(Task* task)
+{
+  Worker* self = currentWorker();
+  if (self != nullptr)
+    self->deque.push(task);
+  else
+    injector_->push(task);
+  // Pairs with the sleeper's check: either it sees the new signal or we
+  // see it sleeping
+  signal_.fetch_add(1);
+  if (sleepers_.load() > 0) {
+    std::lock_guard<std::mutex> guard(sleepLock_);
+    sleepCond_.notify_one();
+  }
+}
+
+ThreadPool::Task* ThreadPool::find(Worker* self)
+{
+  if (self != nullptr) {
+    Task* task = self->deque.pop();
+    if (task != nullptr)
+      return task;
+  }
+  size_t start = 0;
+  if (self != nullptr) {
+    self->random ^= self->random << 13;
+    self->random ^= self->random >> 7;
+    self->random ^= self->random << 17;
+    start = self->random % threadCount_;
+  }
+  for (size_t i = 0; i < threadCount_; i++) {
+    Worker* victim = &workers_[(start + i) % threadCount_];
+    if (victim == self)
+      continue;
+    Task* task = victim->deque.steal();
+    if (task != nullptr)
+      return task;
+  }
+  return injector_->pop();
+}
+
+void ThreadPool::execute(Task* task)
+{
+  Group* group = task->group_;
+  try {
+    task->run();
+  } catch (...) {
+    std::lock_guard<std::mutex> guard(group->errorLock_);
+    if (!group->error_)
+      group->error_ = std::current_exception();
+  }
+  delete task;
+  group->finished();
+}
+
+void ThreadPool::workerMain(Worker* self)
+{
+  currentWorkerSlot = self;
+  unsigned idle = 0;
+  for (;;) {
+    Task* task = find(self);
+    if (task != nullptr) {
+      execute(task);
+      idle = 0;
+      continue;
+    }
+    // Steals fail spuriously under contention, so look a few more times
+    // before going to sleep
+    if (++idle < 64) {
+      if (idle > 16)
+        std::this_thread::yield();
+      continue;
+    }
+    uint64_t signal = signal_.load();
+    task = find(self);
+    if (task != nullptr) {
+      execute(task);
+      idle = 0;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepLock_);
+    if (stopping_.load())
+      return;
+    sleepers_.fetch_add(1);
+    while (signal_.load() == signal)
+      sleepCond_.wait(lock);
+    sleepers_.fetch_sub(1);
+    idle = 0;
+  }
+}
+
+ThreadPool::Group::Group(ThreadPool& pool) :
+  pool_(pool),
+  pending_(0)
+{}
+
+ThreadPool::Group::~Group()
+{
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void ThreadPool::Group::spawn(Task* task)
+{
+  task->group_ = this;
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  pool_.push(task);
+}
+
+void ThreadPool::Group::finished()
+{
+  size_t pending = pending_.load(std::memory_order_relaxed);
+  while (pending > 1) {
+    if (pending_.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+      return;
+  }
+  // Maybe the last task. Reaching zero under the lock means a waiter that
+  // sees zero and then takes the lock once can't return (and destroy the
+  // group) while this is still notifying.
+  std::lock_guard<std::mutex> guard(doneLock_);
+  if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    done_.notify_all();
+}
+
+void ThreadPool::Group::wait()
+{
+  Worker* self = pool_.currentWorker();
+  unsigned idle = 0;
+  while (pending_.load(std::memory_order_acquire) > 0) {
+    Task* task = pool_.find(self);
+    if (task != nullptr) {
+      pool_.execute(task);
+      idle = 0;
+      continue;
+    }
+    ++idle;
+    // A worker must keep running tasks, since the ones it waits for may
+    // be queued behind its own; anyone else sleeps once the pool has
+    // taken all the work
+    if (self == nullptr && idle > 64) {
+      std::unique_lock<std::mutex> lock(doneLock_);
+      while (pending_.load(std::memory_order_acquire) > 0)
+        done_.wait(lock);
+    } else if (idle > 16) {
+      std::this_thread::yield();
+    }
+  }
+  {
+    // The last task may still be inside finished()
+    std::lock_guard<std::mutex> guard(doneLock_);
+  }
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> guard(errorLock_);
+    std::swap(error, error_);
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
@@ -0,0 +1,137 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_ThreadPool_h
+#define __Base_ThreadPool_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Base
+{
+  // Fixed set of worker threads running fork/join style tasks. Each worker
+  // keeps its own Chase-Lev deque: it pushes and pops new tasks at the
+  // bottom, newest first, while idle workers steal the oldest (and, for
+  // divide and conquer work, largest) tasks from the top. Tasks spawned
+  // from outside the pool go through a shared queue. Idle workers sleep
+  // until new work arrives.
+  class ThreadPool {
+    public:
+      class Group;
+
+      // Unit of work; the pool deletes it once run returns
+      class Task {
+        public:
+          virtual ~Task() {}
+          virtual void run() = 0;
+
+        private:
+          friend class ThreadPool;
+          Group* group_ = nullptr;
+      };
+
+      // Tracks a batch of tasks so the spawner can wait for all of them.
+      // Waiting on a worker runs pending tasks instead of blocking, so
+      // tasks may spawn into and wait on their own groups. A thread outside
+      // the pool helps the same way until it runs out of tasks to take,
+      // then sleeps until the last one finishes. The first exception
+      // thrown by a task is rethrown by wait.
+      class Group {
+        public:
+          Group(ThreadPool& pool);
+          Group(Group const&) = delete;
+          Group& operator= (Group const&) = delete;
+          ~Group();
+
+          void spawn(Task* task);
+
+          template <typename F, typename = typename std::enable_if<
+                      !std::is_convertible<F, Task*>::value>::type>
+          void spawn(F function)
+          {
+            spawn(new FunctionTask<F>(std::move(function)));
+          }
+
+          void wait();
+
+          ThreadPool& pool() const { return pool_; }
+
+        private:
+          friend class ThreadPool;
+
+          ThreadPool& pool_;
+          std::atomic<size_t> pending_;
+          std::mutex errorLock_;
+          std::exception_ptr error_;
+          std::mutex doneLock_;
+          std::condition_variable done_;
+
+          void finished();
+      };
+
+      // threads = 0 uses one per hardware thread
+      explicit ThreadPool(size_t threads = 0);
+      ThreadPool(ThreadPool const&) = delete;
+      ThreadPool& operator= (ThreadPool const&) = delete;
+      // Waits for queued tasks, then stops the workers
+      ~ThreadPool();
+
+      size_t threadCount() const { return threadCount_; }
+
+      // Process wide pool with one worker per hardware thread
+      static ThreadPool& shared();
+
+    private:
+      template <typename F>
+      class FunctionTask : public Task {
+        public:
+          FunctionTask(F&& function) : function_(std::move(function)) {}
+          void run() override { function_(); }
+        private:
+          F function_;
+      };
+
+      class Deque;
+      class Injector;
+      struct Worker;
+
+      size_t threadCount_;
+      Worker* workers_;
+      Injector* injector_;
+      std::atomic<bool> stopping_;
+      // Bumped on every push so a worker about to sleep can tell if it
+      // missed one
+      std::atomic<uint64_t> signal_;
+      std::atomic<size_t> sleepers_;
+      std::mutex sleepLock_;
+      std::condition_variable sleepCond_;
+
+      void push(Task* task);
+      Task* find(Worker* self);
+      void execute(Task* task);
+      void workerMain(Worker* self);
+      Worker* currentWorker() const;
+  };
+}
+
+#endif
@@ -0,0 +1,348 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/List.h"
+#include "Base/Stats.h"
+#include "Base/String.h"
+#include "Base/StringView.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Bench;
+
+// Relaxed atomics so threaded benchmarks can allocate without racing
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+
+#ifdef BASE_BENCH_COUNT_ALLOCS
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_calloc(size_t count, size_t size);
+  void* __real_realloc(void* ptr, size_t size);
+  void __real_free(void* ptr);
+
+  void* __wrap_malloc(size_t size)
+  {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return __real_malloc(size);
+  }
+
+  void* __wrap_calloc(size_t count, size_t size)
+  {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(count * size, std::memory_order_relaxed);
+    return __real_calloc(count, size);
+  }
+
+  void* __wrap_realloc(void* ptr, size_t size)
+  {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return __real_realloc(ptr, size);
+  }
+
+  void __wrap_free(void* ptr)
+  {
+    __real_free(ptr);
+  }
+}
+
+// The operator new in libstdc++.so calls its own, unwrapped, malloc, so
+// replace it with one that goes through the wrapper above. Over-aligned
+// new is left alone; nothing measured here uses it.
+void* operator new(size_t size)
+{
+  void* ptr = malloc(size > 0 ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, std::nothrow_t const&) noexcept
+{
+  return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, std::nothrow_t const&) noexcept
+{
+  return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void* ptr, std::nothrow_t const&) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept
+{
+  free(ptr);
+}
+#endif
+
+Allocations Bench::allocations()
+{
+  return Allocations{allocCount.load(std::memory_order_relaxed),
+                     allocBytes.load(std::memory_order_relaxed)};
+}
+
+State::State(size_t count) :
+  count_(count),
+  running_(true),
+  start_(Clock::now()),
+  startAllocs_(Bench::allocations()),
+  seconds_(0),
+  allocs_{0, 0}
+{}
+
+void State::resetTimer()
+{
+  seconds_ = 0;
+  allocs_ = Allocations{0, 0};
+  running_ = false;
+  startTimer();
+}
+
+void State::stopTimer()
+{
+  if (!running_)
+    return;
+  Allocations now = Bench::allocations();
+  seconds_ += std::chrono::duration<double>(Clock::now() - start_).count();
+  allocs_.count += now.count - startAllocs_.count;
+  allocs_.bytes += now.bytes - startAllocs_.bytes;
+  running_ = false;
+}
+
+void State::startTimer()
+{
+  if (running_)
+    return;
+  running_ = true;
+  startAllocs_ = Bench::allocations();
+  start_ = Clock::now();
+}
+
+void State::recordLatency(double seconds)
+{
+  if (latencies_.count() == latencies_.size()) {
+    // Grown outside the timed region, so the samples are not counted as
+    // the benchmark's allocations
+    bool running = running_;
+    stopTimer();
+    latencies_.size(std::max<size_t>(count_, latencies_.size() * 2));
+    if (running)
+      startTimer();
+  }
+  latencies_.add((float)(seconds * 1e9));
+}
+
+namespace {
+  struct Entry {
+    char const* name;
+    Function function;
+  };
+
+  struct Latency {
+    bool recorded;
+    double p50;
+    double p99;
+    double p999;
+    double max;
+  };
+
+  struct Result {
+    char const* name;
+    size_t count;
+    double seconds;
+    Allocations allocs;
+    Latency latency;
+  };
+
+  Base::List<Entry>& registry()
+  {
+    static Base::List<Entry> entries;
+    return entries;
+  }
+
+  Latency percentiles(Base::List<float> const& latencies)
+  {
+    if (latencies.count() == 0)
+      return Latency{false, 0, 0, 0, 0};
+    Base::List<float> sorted(latencies);
+    sorted.sort();
+    size_t last = sorted.count() - 1;
+    auto at = [&](double q) { return (double)sorted[std::min(last, (size_t)(sorted.count() * q))]; };
+    return Latency{true, at(0.5), at(0.99), at(0.999), (double)sorted[last]};
+  }
+
+  Result measure(Entry const& entry, double minTime)
+  {
+    size_t count = 1;
+    for (;;) {
+      State state(count);
+      entry.function(state);
+      state.stopTimer();
+      double seconds = state.seconds();
+      if (seconds >= minTime || count >= ((size_t)1 << 34))
+        return Result{entry.name, count, seconds, state.allocations(),
+                      percentiles(state.latencies())};
+      // Aim 20% past the target, but grow at least 2x and at most 100x
+      size_t next = seconds > 0 ? (size_t)(count * minTime * 1.2 / seconds) : count * 100;
+      count = std::min(std::max(next, count * 2), count * 100);
+    }
+  }
+
+  void printCsvHeader()
+  {
+    printf("name,iterations,ns_per_op,ops_per_sec,allocs_per_op,bytes_per_op,"
+           "p50_ns,p99_ns,p999_ns,max_ns\n");
+  }
+
+  void printCsv(Result const& r)
+  {
+    printf("%s,%zu,%.3f,%.0f,%.4f,%.2f", r.name, r.count,
+           r.seconds * 1e9 / r.count, r.count / r.seconds,
+           (double)r.allocs.count / r.count, (double)r.allocs.bytes / r.count);
+    if (r.latency.recorded)
+      printf(",%.0f,%.0f,%.0f,%.0f\n", r.latency.p50, r.latency.p99,
+             r.latency.p999, r.latency.max);
+    else
+      printf(",,,,\n");
+    fflush(stdout);
+  }
+
+  void printJson(Result const& r, bool first)
+  {
+    printf("%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, "
+           "\"ops_per_sec\": %.0f, \"allocs_per_op\": %.4f, \"bytes_per_op\": %.2f",
+           first ? "" : ",", r.name, r.count, r.seconds * 1e9 / r.count,
+           r.count / r.seconds, (double)r.allocs.count / r.count,
+           (double)r.allocs.bytes / r.count);
+    if (r.latency.recorded)
+      printf(", \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, \"max_ns\": %.0f",
+             r.latency.p50, r.latency.p99, r.latency.p999, r.latency.max);
+    printf("}");
+    fflush(stdout);
+  }
+
+  void usage(char const* argv0)
+  {
+    fprintf(stderr,
+            "usage: %s [--format=csv|json] [--filter=TEXT] [--min-time=SECONDS] [--list]\n"
+            "          [--stats=FILE]\n",
+            argv0);
+  }
+}
+
+Registration::Registration(char const* name, Function function)
+{
+  registry().add(Entry{name, function});
+}
+
+int main(int argc, char** argv)
+{
+  bool json = false;
+  bool list = false;
+  char const* filter = "";
+  char const* statsPath = nullptr;
+  double minTime = 0.2;
+
+  for (int i = 1; i < argc; i++) {
+    Base::StringView arg(argv[i]);
+    if (arg == "--format=json") {
+      json = true;
+    } else if (arg == "--format=csv") {
+      json = false;
+    } else if (arg.startsWith("--filter=")) {
+      filter = argv[i] + strlen("--filter=");
+    } else if (arg.startsWith("--min-time=")) {
+      minTime = atof(argv[i] + strlen("--min-time="));
+    } else if (arg == "--list") {
+      list = true;
+    } else if (arg.startsWith("--stats=")) {
+      statsPath = argv[i] + strlen("--stats=");
+    } else {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  Base::List<Entry>& entries = registry();
+  bool first = true;
+  if (json && !list)
+    printf("{\n  \"allocs_counted\": %s,\n  \"results\": [",
+#ifdef BASE_BENCH_COUNT_ALLOCS
+           "true"
+#else
+           "false"
+#endif
+           );
+  else if (!list)
+    printCsvHeader();
+
+  for (off_t i = 0; i < (ssize_t)entries.count(); i++) {
+    Entry const& entry = entries[i];
+    if (!Base::StringView(entry.name).contains(filter))
+      continue;
+    if (list) {
+      printf("%s\n", entry.name);
+      continue;
+    }
+    Result result = measure(entry, minTime);
+    if (json)
+      printJson(result, first);
+    else
+      printCsv(result);
+    first = false;
+  }
+
+  if (json && !list)
+    printf("\n  ]\n}\n");
+
+  // Container counters over the whole run; empty unless built with BASE_STATS
+  if (statsPath != nullptr) {
+    FILE* file = fopen(statsPath, "w");
+    if (file == nullptr) {
+      perror(statsPath);
+      return 1;
+    }
+    fprintf(file, "%s\n", Base::Stats::json().c_str());
+    fclose(file);
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __Base_bench_Bench_h
+#define __Base_bench_Bench_h
+
+#include "Base/List.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+
+// Minimal microbenchmark harness for base_bench. A benchmark is a function
+// that performs state.count() operations; the harness grows the count until
+// a run takes long enough to time, then reports ns/op, ops/sec and the
+// allocations made per op (when BASE_BENCH_COUNT_ALLOCS is available), plus
+// latency percentiles for benchmarks that record them.
+namespace Bench
+{
+  struct Allocations {
+    uint64_t count;
+    uint64_t bytes;
+  };
+
+  Allocations allocations();
+
+  class State {
+    public:
+      State(size_t count);
+
+      size_t count() const { return count_; }
+
+      // Exclude setup done so far from the measurement
+      void resetTimer();
+      // Bracket per-batch setup that should not be measured
+      void stopTimer();
+      void startTimer();
+      // For benchmarks that time their ops one by one: records one op's
+      // time, and the report adds percentiles of the recorded times
+      void recordLatency(double seconds);
+
+      double seconds() const { return seconds_; }
+      Allocations allocations() const { return allocs_; }
+      // Recorded op times in ns
+      Base::List<float> const& latencies() const { return latencies_; }
+
+    private:
+      typedef std::chrono::steady_clock Clock;
+
+      size_t count_;
+      bool running_;
+      Clock::time_point start_;
+      Allocations startAllocs_;
+      double seconds_;
+      Allocations allocs_;
+      Base::List<float> latencies_;
+  };
+
+  typedef void (*Function)(State& state);
+
+  class Registration {
+    public:
+      Registration(char const* name, Function function);
+  };
+
+  // Keeps the compiler from discarding a value that is otherwise unused
+  template <typename T>
+  inline void keep(T const& value)
+  {
+    asm volatile("" : : "r"(&value) : "memory");
+  }
+}
+
+#define BENCH(group, name)                                            \
+  static void bench_##group##_##name(Bench::State& state);            \
+  static Bench::Registration reg_##group##_##name(#group "/" #name,   \
+                                                  bench_##group##_##name); \
+  static void bench_##group##_##name(Bench::State& state)
+
+#endif
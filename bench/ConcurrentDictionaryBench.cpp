@@ -0,0 +1,129 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/ConcurrentDictionary.h"
+#include "Base/Dictionary.h"
+#include "Base/RcuDictionary.h"
+
+#include <mutex>
+#include <thread>
+
+using namespace Base;
+
+// Scaling of ConcurrentDictionary and RcuDictionary against a Dictionary
+// behind one mutex.
+// Each op is a random key from a prefilled table; reads are tryGet and
+// writes alternate add and remove so the table stays near its starting
+// size. state.count() ops are split across the threads, so ns/op is wall
+// time per op and falls as the dictionary scales.
+
+static const size_t KeyCount = 1 << 16;
+
+class LockedDictionary {
+  public:
+    bool add(uint64_t key, uint64_t value)
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (dict_.containsKey(key))
+        return false;
+      dict_.add(key, value);
+      return true;
+    }
+
+    bool remove(uint64_t key)
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!dict_.containsKey(key))
+        return false;
+      dict_.remove(key);
+      return true;
+    }
+
+    bool tryGet(uint64_t key, uint64_t& value)
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!dict_.containsKey(key))
+        return false;
+      value = dict_[key];
+      return true;
+    }
+
+  private:
+    std::mutex mutex_;
+    Dictionary<uint64_t, uint64_t> dict_;
+};
+
+// writePercent of the ops are writes, the rest are reads
+template <typename D>
+static void mix(Bench::State& state, unsigned threads, unsigned writePercent)
+{
+  D dict;
+  for (uint64_t i = 0; i < KeyCount; i += 2)
+    dict.add(i, i);
+  size_t perThread = state.count() / threads + 1;
+  List<std::thread> workers;
+  state.resetTimer();
+  for (unsigned t = 0; t < threads; t++) {
+    workers.add(std::thread([&dict, perThread, writePercent, t]() {
+      uint64_t x = 0x9e3779b97f4a7c15ull * (t + 1);
+      uint64_t sum = 0;
+      for (size_t i = 0; i < perThread; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        uint64_t key = x % KeyCount;
+        if ((x >> 32) % 100 < writePercent) {
+          if (i & 1)
+            dict.add(key, key);
+          else
+            dict.remove(key);
+        } else {
+          uint64_t value;
+          if (dict.tryGet(key, value))
+            sum += value;
+        }
+      }
+      Bench::keep(sum);
+    }));
+  }
+  for (size_t t = 0; t < workers.count(); t++)
+    workers[t].join();
+}
+
+#define SCALING_BENCHES(group, D, threads)                                      \
+  BENCH(group, read_only_##threads)                                             \
+  { mix<D>(state, threads, 0); }                                                \
+  BENCH(group, read_heavy_##threads)                                            \
+  { mix<D>(state, threads, 5); }                                                \
+  BENCH(group, write_heavy_##threads)                                           \
+  { mix<D>(state, threads, 50); }
+
+#define SCALING_GROUP(group, D)                                                 \
+  SCALING_BENCHES(group, D, 1)                                                  \
+  SCALING_BENCHES(group, D, 2)                                                  \
+  SCALING_BENCHES(group, D, 4)                                                  \
+  SCALING_BENCHES(group, D, 8)                                                  \
+  SCALING_BENCHES(group, D, 16)                                                 \
+  SCALING_BENCHES(group, D, 32)                                                 \
+  SCALING_BENCHES(group, D, 64)
+
+typedef ConcurrentDictionary<uint64_t, uint64_t> Concurrent;
+typedef RcuDictionary<uint64_t, uint64_t> Rcu;
+
+SCALING_GROUP(ConcurrentDictionary, Concurrent)
+SCALING_GROUP(RcuDictionary, Rcu)
+SCALING_GROUP(LockedDictionary, LockedDictionary)
@@ -0,0 +1,421 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Atom.h"
+#include "Base/Dictionary.h"
+#include "Base/FlatDictionary.h"
+#include "Base/String.h"
+
+#include <stdio.h>
+
+using namespace Base;
+
+// Dictionary and FlatDictionary share an API, so each scenario is written
+// once and instantiated for both. Tables hold TableSize keys; misses use
+// keys from a disjoint range.
+static const size_t TableSize = 1 << 16;
+
+static List<String> makeKeys(size_t count, size_t offset)
+{
+  List<String> keys(count);
+  char buf[32];
+  for (size_t i = 0; i < count; i++) {
+    snprintf(buf, sizeof(buf), "key:%zu", i + offset);
+    keys.add(buf);
+  }
+  return keys;
+}
+
+template <typename D, typename K>
+static void fill(D& dict, List<K> const& keys)
+{
+  for (off_t i = 0; i < (ssize_t)keys.count(); i++)
+    dict.add(keys[i], (int)i);
+}
+
+static List<uint64_t> makeIntKeys(size_t count, size_t offset)
+{
+  List<uint64_t> keys(count);
+  for (size_t i = 0; i < count; i++)
+    keys.add((i + offset) * 0x10001);
+  return keys;
+}
+
+// One op inserts a single key, growing from the default size
+template <typename D, typename K>
+static void insert(Bench::State& state, List<K> const& keys)
+{
+  state.resetTimer();
+  size_t done = 0;
+  while (done < state.count()) {
+    D dict;
+    size_t n = std::min(keys.count(), state.count() - done);
+    for (size_t i = 0; i < n; i++)
+      dict.add(keys[i], (int)i);
+    done += n;
+    state.stopTimer();
+    // destruction is measured by the remove benchmarks
+    { D drop(std::move(dict)); }
+    state.startTimer();
+  }
+}
+
+template <typename D, typename K>
+static void lookup(Bench::State& state, List<K> const& keys, List<K> const& probes)
+{
+  D dict;
+  fill(dict, keys);
+  state.resetTimer();
+  size_t found = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    found += dict.containsKey(probes[i & (TableSize - 1)]);
+  Bench::keep(found);
+}
+
+template <typename D, typename K>
+static void get(Bench::State& state, List<K> const& keys)
+{
+  D dict;
+  fill(dict, keys);
+  state.resetTimer();
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    sum += dict[keys[i & (TableSize - 1)]];
+  Bench::keep(sum);
+}
+
+template <typename D, typename K>
+static void removeKeys(Bench::State& state, List<K> const& keys)
+{
+  size_t done = 0;
+  while (done < state.count()) {
+    state.stopTimer();
+    D dict;
+    fill(dict, keys);
+    state.startTimer();
+    size_t n = std::min(keys.count(), state.count() - done);
+    for (size_t i = 0; i < n; i++)
+      dict.remove(keys[i]);
+    done += n;
+  }
+}
+
+// One op visits a single entry
+template <typename D, typename K>
+static void iterate(Bench::State& state, List<K> const& keys)
+{
+  D dict;
+  fill(dict, keys);
+  state.resetTimer();
+  int64_t sum = 0;
+  for (size_t done = 0; done < state.count(); done += keys.count()) {
+    for (auto it = dict.iter(); it.valid(); it.next())
+      sum += it.value().value;
+  }
+  Bench::keep(sum);
+}
+
+// One op rehashes a single entry into a fresh table (via copy)
+template <typename D, typename K>
+static void rehash(Bench::State& state, List<K> const& keys)
+{
+  D dict;
+  fill(dict, keys);
+  state.resetTimer();
+  for (size_t done = 0; done < state.count(); done += keys.count()) {
+    D copy(dict);
+    Bench::keep(copy);
+  }
+}
+
+// Long running churn on a table of ChurnSize int keys, built once per
+// table type: one op removes the oldest key and adds a new one
+static const size_t ChurnSize = 10000000;
+
+template <typename D>
+static void churn(Bench::State& state)
+{
+  static D* dict = nullptr;
+  static uint64_t oldest = 0;
+  if (dict == nullptr) {
+    dict = new D();
+    for (uint64_t i = 0; i < ChurnSize; i++)
+      dict->add(i * 0x10001, (int)i);
+  }
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    dict->remove(oldest * 0x10001);
+    dict->add((oldest + ChurnSize) * 0x10001, (int)i);
+    oldest++;
+  }
+}
+
+// One op inserts a key and later removes it, in cycles that fill the same
+// table with ChurnSize keys and empty it again
+template <typename D>
+static void cycle(Bench::State& state)
+{
+  static D* dict = nullptr;
+  if (dict == nullptr)
+    dict = new D();
+  state.resetTimer();
+  size_t done = 0;
+  while (done < state.count()) {
+    size_t n = std::min(ChurnSize, state.count() - done);
+    for (uint64_t i = 0; i < n; i++)
+      dict->add(i * 0x10001, (int)i);
+    for (uint64_t i = 0; i < n; i++)
+      dict->remove(i * 0x10001);
+    done += n;
+  }
+}
+
+enum class Growth { Rehash, Incremental, Reserved };
+
+// One op inserts a single int key into a Dictionary growing towards
+// ChurnSize keys, timed on its own so the report shows the latency spikes
+// of growing the table
+static void insertLatency(Bench::State& state, Growth growth)
+{
+  typedef std::chrono::steady_clock Clock;
+  state.resetTimer();
+  size_t done = 0;
+  while (done < state.count()) {
+    state.stopTimer();
+    Dictionary<uint64_t, int> dict;
+    size_t n = std::min(ChurnSize, state.count() - done);
+    if (growth == Growth::Incremental)
+      dict.setIncrementalRehash(true);
+    else if (growth == Growth::Reserved)
+      dict.reserve(n);
+    state.startTimer();
+    for (uint64_t i = 0; i < n; i++) {
+      Clock::time_point start = Clock::now();
+      dict.add(i * 0x10001, (int)i);
+      state.recordLatency(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    done += n;
+    state.stopTimer();
+    { Dictionary<uint64_t, int> drop(std::move(dict)); }
+    state.startTimer();
+  }
+}
+
+BENCH(Dictionary, insert_latency_rehash) { insertLatency(state, Growth::Rehash); }
+BENCH(Dictionary, insert_latency_incremental) { insertLatency(state, Growth::Incremental); }
+BENCH(Dictionary, insert_latency_reserved) { insertLatency(state, Growth::Reserved); }
+
+// Path-like keys of about 64 chars, long enough that hashing a key costs
+// more than placing its node
+static List<String> const& longStringKeys()
+{
+  static List<String> keys;
+  if (keys.count() == 0) {
+    keys.size(ChurnSize);
+    char buf[80];
+    for (size_t i = 0; i < ChurnSize; i++) {
+      snprintf(buf, sizeof(buf), "/srv/data/customers/region-eu-west/accounts/%016zx/profile", i);
+      keys.add(buf);
+    }
+  }
+  return keys;
+}
+
+// One op inserts a single long String key into a Dictionary growing from
+// empty to ChurnSize keys; growing rehashes every node already in the
+// table, which the reserved case never does
+static void growString(Bench::State& state, bool reserve)
+{
+  List<String> const& keys = longStringKeys();
+  state.resetTimer();
+  size_t done = 0;
+  while (done < state.count()) {
+    size_t n = std::min(ChurnSize, state.count() - done);
+    Dictionary<String, int> dict;
+    if (reserve)
+      dict.reserve(n);
+    for (size_t i = 0; i < n; i++)
+      dict.add(keys[i], (int)i);
+    done += n;
+    state.stopTimer();
+    { Dictionary<String, int> drop(std::move(dict)); }
+    state.startTimer();
+  }
+}
+
+BENCH(Dictionary, grow_string_10M) { growString(state, false); }
+BENCH(Dictionary, grow_string_10M_reserved) { growString(state, true); }
+
+static List<String> const& stringKeys()
+{
+  static List<String> keys = makeKeys(TableSize, 0);
+  return keys;
+}
+
+static List<String> const& stringMisses()
+{
+  static List<String> keys = makeKeys(TableSize, TableSize);
+  return keys;
+}
+
+static List<uint64_t> const& intKeys()
+{
+  static List<uint64_t> keys = makeIntKeys(TableSize, 0);
+  return keys;
+}
+
+static List<uint64_t> const& intMisses()
+{
+  static List<uint64_t> keys = makeIntKeys(TableSize, TableSize);
+  return keys;
+}
+
+static List<Atom> const& atomKeys()
+{
+  static List<Atom> keys;
+  if (keys.count() == 0) {
+    for (off_t i = 0; i < (ssize_t)TableSize; i++)
+      keys.add(Atom(stringKeys()[i]));
+  }
+  return keys;
+}
+
+#define DICT_BENCHES(group, D)                                                  \
+  BENCH(group, insert_string)                                                   \
+  { insert<D<String, int>>(state, stringKeys()); }                              \
+  BENCH(group, insert_int)                                                      \
+  { insert<D<uint64_t, int>>(state, intKeys()); }                               \
+  BENCH(group, lookup_hit_string)                                               \
+  { lookup<D<String, int>>(state, stringKeys(), stringKeys()); }                \
+  BENCH(group, lookup_miss_string)                                              \
+  { lookup<D<String, int>>(state, stringKeys(), stringMisses()); }              \
+  BENCH(group, lookup_hit_atom)                                                 \
+  { lookup<D<Atom, int>>(state, atomKeys(), atomKeys()); }                      \
+  BENCH(group, lookup_hit_int)                                                  \
+  { lookup<D<uint64_t, int>>(state, intKeys(), intKeys()); }                    \
+  BENCH(group, lookup_miss_int)                                                 \
+  { lookup<D<uint64_t, int>>(state, intKeys(), intMisses()); }                  \
+  BENCH(group, get_string)                                                      \
+  { get<D<String, int>>(state, stringKeys()); }                                 \
+  BENCH(group, remove_string)                                                   \
+  { removeKeys<D<String, int>>(state, stringKeys()); }                           \
+  BENCH(group, iterate)                                                         \
+  { iterate<D<uint64_t, int>>(state, intKeys()); }                              \
+  BENCH(group, rehash_string)                                                   \
+  { rehash<D<String, int>>(state, stringKeys()); }                              \
+  BENCH(group, churn_int_10M)                                                   \
+  { churn<D<uint64_t, int>>(state); }                                           \
+  BENCH(group, cycle_int_10M)                                                   \
+  { cycle<D<uint64_t, int>>(state); }
+
+DICT_BENCHES(Dictionary, Dictionary)
+DICT_BENCHES(FlatDictionary, FlatDictionary)
+
+// Request routing style lookups: String keys searched by char const*,
+// once by building a String as callers had to, once directly as a view
+static List<char const*> const& cstrKeys()
+{
+  static List<char const*> keys;
+  if (keys.count() == 0) {
+    for (off_t i = 0; i < (ssize_t)TableSize; i++)
+      keys.add(stringKeys()[i].c_str());
+  }
+  return keys;
+}
+
+BENCH(Dictionary, lookup_cstr_copy)
+{
+  Dictionary<String, int> dict;
+  fill(dict, stringKeys());
+  List<char const*> const& probes = cstrKeys();
+  state.resetTimer();
+  size_t found = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    found += dict.containsKey(String(probes[i & (TableSize - 1)]));
+  Bench::keep(found);
+}
+
+BENCH(Dictionary, lookup_cstr)
+{
+  Dictionary<String, int> dict;
+  fill(dict, stringKeys());
+  List<char const*> const& probes = cstrKeys();
+  state.resetTimer();
+  size_t found = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    found += dict.containsKey(probes[i & (TableSize - 1)]);
+  Bench::keep(found);
+}
+
+// Half the probes miss; one op is a "read it if present"
+BENCH(Dictionary, get_contains_index)
+{
+  Dictionary<String, int> dict;
+  fill(dict, stringKeys());
+  List<String> const& hits = stringKeys();
+  List<String> const& misses = stringMisses();
+  state.resetTimer();
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++) {
+    String const& key = (i & 1 ? misses : hits)[(i >> 1) & (TableSize - 1)];
+    if (dict.containsKey(key))
+      sum += dict[key];
+  }
+  Bench::keep(sum);
+}
+
+BENCH(Dictionary, get_tryGet)
+{
+  Dictionary<String, int> dict;
+  fill(dict, stringKeys());
+  List<String> const& hits = stringKeys();
+  List<String> const& misses = stringMisses();
+  state.resetTimer();
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++) {
+    String const& key = (i & 1 ? misses : hits)[(i >> 1) & (TableSize - 1)];
+    if (int* value = dict.tryGet(key))
+      sum += *value;
+  }
+  Bench::keep(sum);
+}
+
+// One op counts a hit on a char const* key, adding it on first sight
+BENCH(Dictionary, count_contains_add)
+{
+  List<char const*> const& keys = cstrKeys();
+  Dictionary<String, int> dict;
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    String key(keys[i & (TableSize - 1)]);
+    if (dict.containsKey(key))
+      dict[key] += 1;
+    else
+      dict.add(key, 1);
+  }
+  Bench::keep(dict.count());
+}
+
+BENCH(Dictionary, count_getOrAdd)
+{
+  List<char const*> const& keys = cstrKeys();
+  Dictionary<String, int> dict;
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++)
+    dict.getOrAdd(keys[i & (TableSize - 1)], [] { return 0; }) += 1;
+  Bench::keep(dict.count());
+}
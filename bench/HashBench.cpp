@@ -0,0 +1,52 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/bench/Bench.h"
+#include "Base/Hash.h"
+#include "Base/List.h"
+
+using namespace Base;
+
+// Hash::bytes over buffers of one length; one op hashes one buffer, so
+// bytes/s is the length times ops_per_sec. Sixteen buffers are rotated so
+// that the hash can't be hoisted out of the loop.
+static void bytes(Bench::State& state, size_t length)
+{
+  List<char> data(length + 16);
+  for (size_t i = 0; i < length + 16; i++)
+    data.add((char)(i * 131 + 7));
+  state.resetTimer();
+  uint64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    sum += Hash::bytes(&data[i & 15], length);
+  Bench::keep(sum);
+}
+
+BENCH(Hash, bytes_4) { bytes(state, 4); }
+BENCH(Hash, bytes_16) { bytes(state, 16); }
+BENCH(Hash, bytes_64) { bytes(state, 64); }
+BENCH(Hash, bytes_256) { bytes(state, 256); }
+BENCH(Hash, bytes_4K) { bytes(state, 4 << 10); }
+BENCH(Hash, bytes_1M) { bytes(state, 1 << 20); }
+
+BENCH(Hash, integer)
+{
+  uint64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    sum += hash<uint64_t>(sum + i);
+  Bench::keep(sum);
+}
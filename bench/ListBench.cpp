@@ -0,0 +1,173 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Arena.h"
+#include "Base/List.h"
+#include "Base/String.h"
+
+using namespace Base;
+
+// One op adds a single item; growth is included by restarting every 64K
+BENCH(List, add_int)
+{
+  List<int> list;
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 65535) == 0)
+      list = List<int>();
+    list.add((int)i);
+  }
+  Bench::keep(list);
+}
+
+BENCH(List, add_string)
+{
+  List<String> list;
+  String item("a list item");
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 65535) == 0)
+      list = List<String>();
+    list.add(item);
+  }
+  Bench::keep(list);
+}
+
+BENCH(List, add_string_arena)
+{
+  Arena arena(SZ_1M);
+  List<String>* list = nullptr;
+  String item("a list item");
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 65535) == 0) {
+      delete list;
+      arena.reset();
+      list = new List<String>(0, &arena);
+    }
+    list->emplace(item, &arena);
+  }
+  delete list;
+}
+
+// Footprint of a List<String>: one op adds one copy of a string to a list
+// sized up front, so bytes_per_op is what each element costs on the heap,
+// sizeof(String) included
+static void footprint(Bench::State& state, String const& item)
+{
+  state.resetTimer();
+  List<String> list(state.count());
+  for (size_t i = 0; i < state.count(); i++)
+    list.add(item);
+  state.stopTimer();
+  Bench::keep(list);
+}
+
+// Fits inline, so only the list's own buffer is counted
+BENCH(List, footprint_short)
+{
+  footprint(state, String("tag:short"));
+}
+
+BENCH(List, footprint_long)
+{
+  footprint(state, String("tag:a description long enough to go to the heap"));
+}
+
+BENCH(List, footprint_long_shared)
+{
+  String item("tag:a description long enough to go to the heap");
+  item.share();
+  footprint(state, item);
+}
+
+BENCH(List, insert_front_1k)
+{
+  List<int> list;
+  for (size_t i = 0; i < state.count(); i++) {
+    if (list.count() == 1024)
+      list = List<int>();
+    list.insert(0, (int)i);
+  }
+  Bench::keep(list);
+}
+
+BENCH(List, remove_front_1k)
+{
+  List<int> list;
+  for (size_t i = 0; i < state.count(); i++) {
+    if (list.count() == 0) {
+      state.stopTimer();
+      for (int j = 0; j < 1024; j++)
+        list.add(j);
+      state.startTimer();
+    }
+    list.remove(0);
+  }
+}
+
+BENCH(List, remove_back)
+{
+  List<String> list;
+  for (size_t i = 0; i < state.count(); i++) {
+    if (list.count() == 0) {
+      state.stopTimer();
+      for (int j = 0; j < 4096; j++)
+        list.add("item");
+      state.startTimer();
+    }
+    list.remove(list.count() - 1);
+  }
+}
+
+// One op copies one item of a 1K item list
+BENCH(List, copy_string)
+{
+  List<String> src;
+  for (int i = 0; i < 1024; i++)
+    src.add("copied item");
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i += 1024) {
+    List<String> copy(src);
+    Bench::keep(copy);
+  }
+}
+
+BENCH(List, iterate)
+{
+  List<int> list;
+  for (int i = 0; i < 4096; i++)
+    list.add(i);
+  state.resetTimer();
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i += 4096) {
+    for (auto it = list.iter(); it.valid(); it.next())
+      sum += it.value();
+  }
+  Bench::keep(sum);
+}
+
+BENCH(List, index)
+{
+  List<int> list;
+  for (int i = 0; i < 4096; i++)
+    list.add(i);
+  state.resetTimer();
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    sum += list[i & 4095];
+  Bench::keep(sum);
+}
@@ -0,0 +1,191 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Arena.h"
+#include "Base/Dictionary.h"
+#include "Base/MappedFile.h"
+#include "Base/String.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Base;
+
+// Line iteration over a log-like file: MappedFile::lines, a split over the
+// mapped view, and the old path of reading into a String and calling
+// split("\n"). One op is one full pass over the file, so bytes/s is the
+// file length times ops_per_sec.
+
+static const size_t SmallLength = 1 << 20;
+static const size_t LargeLength = 256 << 20;
+
+// Written once per size under /tmp and removed at exit
+static char const* logFile(size_t length)
+{
+  static char smallPath[] = "/tmp/base_bench_log_XXXXXX";
+  static char largePath[] = "/tmp/base_bench_log_XXXXXX";
+  static bool smallMade = false;
+  static bool largeMade = false;
+  char* path = length == SmallLength ? smallPath : largePath;
+  bool& made = length == SmallLength ? smallMade : largeMade;
+  if (made)
+    return path;
+
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    exit(1);
+  }
+  FILE* file = fdopen(fd, "w");
+  uint32_t seed = 12345;
+  size_t written = 0;
+  for (size_t line = 0; written < length; line++) {
+    seed = seed * 1664525 + 1013904223;
+    // Mostly short lines with the occasional long one, like a service log
+    int pad = (seed >> 8) % 16 == 0 ? (seed >> 12) % 400 : (seed >> 12) % 60;
+    int n = fprintf(file, "2024-01-01T00:00:%02zu.%06zu INFO worker-%u request %zu %.*s\n",
+      line / 1000000 % 60, line % 1000000, seed >> 28, line, pad,
+      "................................................................................"
+      "................................................................................"
+      "................................................................................"
+      "................................................................................"
+      "................................................................................");
+    written += n;
+  }
+  fclose(file);
+  made = true;
+  atexit([]() {
+    if (smallMade)
+      unlink(smallPath);
+    if (largeMade)
+      unlink(largePath);
+  });
+  return path;
+}
+
+static void mappedLines(Bench::State& state, size_t length)
+{
+  char const* path = logFile(length);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    MappedFile file(path);
+    size_t chars = 0;
+    for (auto it = file.lines(); it.valid(); it.next())
+      chars += it.value().length();
+    Bench::keep(chars);
+  }
+}
+
+static void mappedSplit(Bench::State& state, size_t length)
+{
+  char const* path = logFile(length);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    MappedFile file(path);
+    size_t chars = 0;
+    for (auto it = file.view().split("\n"); it.valid(); it.next())
+      chars += it.value().length();
+    Bench::keep(chars);
+  }
+}
+
+static void readSplit(Bench::State& state, size_t length)
+{
+  char const* path = logFile(length);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    int fd = open(path, O_RDONLY);
+    char* buffer = (char*)malloc(length + SZ_64K + 1);
+    size_t total = 0;
+    ssize_t got;
+    while ((got = read(fd, buffer + total, length + SZ_64K - total)) > 0)
+      total += got;
+    close(fd);
+    buffer[total] = '\0';
+    String content(buffer);
+    free(buffer);
+    size_t chars = 0;
+    List<String> lines = content.split("\n");
+    for (auto it = lines.iter(); it.valid(); it.next())
+      chars += it.value().length();
+    Bench::keep(chars);
+  }
+}
+
+// Parses every line and indexes it by its worker field: the index owns a
+// copy of each line, so a pass makes one String per line plus the lists
+// and nodes holding them. alloc is passed to all of them.
+typedef Dictionary<String, List<String>> LineIndex;
+
+static void indexLines(LineIndex& index, MappedFile const& file, Allocator* alloc)
+{
+  for (auto it = file.lines(); it.valid(); it.next()) {
+    StringView line = it.value();
+    auto fields = line.split(" ");
+    for (int i = 0; i < 2 && fields.valid(); i++)
+      fields.next();
+    if (!fields.valid())
+      continue;
+    List<String>* lines = index.tryGet(fields.value());
+    if (lines == nullptr)
+      lines = &index.emplace(String(fields.value(), alloc), 0, alloc);
+    lines->emplace(line, alloc);
+  }
+}
+
+// Every allocation is on the heap and the index is torn down entry by
+// entry at the end of the pass
+static void indexHeap(Bench::State& state, size_t length)
+{
+  char const* path = logFile(length);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    MappedFile file(path);
+    LineIndex index;
+    indexLines(index, file, nullptr);
+    Bench::keep(index.count());
+  }
+}
+
+// Everything comes from one arena, and the index is dropped without
+// running its destructor by resetting the arena, as a request would
+static void indexArena(Bench::State& state, size_t length)
+{
+  char const* path = logFile(length);
+  Arena arena(SZ_1M);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    MappedFile file(path);
+    alignas(LineIndex) char storage[sizeof(LineIndex)];
+    LineIndex* index = new (storage)LineIndex(4, &arena);
+    indexLines(*index, file, &arena);
+    Bench::keep(index->count());
+    arena.reset();
+  }
+}
+
+#define MAPPED_FILE_BENCHES(size, length)                                       \
+  BENCH(MappedFile, size##_lines) { mappedLines(state, length); }              \
+  BENCH(MappedFile, size##_split_view) { mappedSplit(state, length); }         \
+  BENCH(MappedFile, size##_read_split) { readSplit(state, length); }           \
+  BENCH(MappedFile, size##_index_heap) { indexHeap(state, length); }           \
+  BENCH(MappedFile, size##_index_arena) { indexArena(state, length); }
+
+MAPPED_FILE_BENCHES(1M, SmallLength)
+MAPPED_FILE_BENCHES(256M, LargeLength)
@@ -0,0 +1,111 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Parallel.h"
+
+using namespace Base;
+
+// Scaling of parallelMap and parallelReduce over Lists of 1M and 100M
+// ints, against a plain ListIter loop. One op is one pass over the list.
+
+static const size_t SmallCount = 1000000;
+static const size_t LargeCount = 100000000;
+
+// Built once, on first use, since the large list takes a while
+static List<int> const& items(size_t count)
+{
+  static List<int> small;
+  static List<int> large;
+  List<int>& list = count == SmallCount ? small : large;
+  if (list.count() == 0) {
+    list = List<int>(count);
+    for (size_t i = 0; i < count; i++)
+      list.add((int)(i * 2654435761u));
+  }
+  return list;
+}
+
+static void sequentialMap(Bench::State& state, size_t count)
+{
+  List<int> const& list = items(count);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    List<int64_t> out(list.count());
+    for (auto it = list.iter(); it.valid(); it.next())
+      out.add((int64_t)it.value() * 3 + 1);
+    Bench::keep(out);
+  }
+}
+
+static void sequentialReduce(Bench::State& state, size_t count)
+{
+  List<int> const& list = items(count);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    int64_t sum = 0;
+    for (auto it = list.iter(); it.valid(); it.next())
+      sum += it.value();
+    Bench::keep(sum);
+  }
+}
+
+static void map(Bench::State& state, size_t count, size_t threads)
+{
+  List<int> const& list = items(count);
+  ThreadPool pool(threads);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    List<int64_t> out = parallelMap(list, [](int const& x) { return (int64_t)x * 3 + 1; }, pool);
+    Bench::keep(out);
+  }
+}
+
+static void reduce(Bench::State& state, size_t count, size_t threads)
+{
+  List<int> const& list = items(count);
+  ThreadPool pool(threads);
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    int64_t sum = parallelReduce(list, (int64_t)0,
+      [](int64_t sum, int const& x) { return sum + x; },
+      [](int64_t a, int64_t b) { return a + b; }, pool);
+    Bench::keep(sum);
+  }
+}
+
+#define PARALLEL_BENCHES(size, count)                                           \
+  BENCH(Parallel, map_##size##_sequential) { sequentialMap(state, count); }     \
+  BENCH(Parallel, reduce_##size##_sequential) { sequentialReduce(state, count); } \
+  BENCH(Parallel, map_##size##_1) { map(state, count, 1); }                     \
+  BENCH(Parallel, map_##size##_2) { map(state, count, 2); }                     \
+  BENCH(Parallel, map_##size##_4) { map(state, count, 4); }                     \
+  BENCH(Parallel, map_##size##_8) { map(state, count, 8); }                     \
+  BENCH(Parallel, map_##size##_16) { map(state, count, 16); }                   \
+  BENCH(Parallel, map_##size##_32) { map(state, count, 32); }                   \
+  BENCH(Parallel, map_##size##_64) { map(state, count, 64); }                   \
+  BENCH(Parallel, map_##size##_all) { map(state, count, 0); }                   \
+  BENCH(Parallel, reduce_##size##_1) { reduce(state, count, 1); }               \
+  BENCH(Parallel, reduce_##size##_2) { reduce(state, count, 2); }               \
+  BENCH(Parallel, reduce_##size##_4) { reduce(state, count, 4); }               \
+  BENCH(Parallel, reduce_##size##_8) { reduce(state, count, 8); }               \
+  BENCH(Parallel, reduce_##size##_16) { reduce(state, count, 16); }             \
+  BENCH(Parallel, reduce_##size##_32) { reduce(state, count, 32); }             \
+  BENCH(Parallel, reduce_##size##_64) { reduce(state, count, 64); }             \
+  BENCH(Parallel, reduce_##size##_all) { reduce(state, count, 0); }
+
+PARALLEL_BENCHES(1M, SmallCount)
+PARALLEL_BENCHES(100M, LargeCount)
@@ -0,0 +1,214 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/MpmcQueue.h"
+#include "Base/Queue.h"
+#include "Base/SpscQueue.h"
+#include "Base/String.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace Base;
+
+// One op is an enqueue and a dequeue on a queue that stays near empty
+BENCH(Queue, enqueue_dequeue)
+{
+  Queue<int> queue;
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++) {
+    queue.enqueue((int)i);
+    sum += queue.dequeue();
+  }
+  Bench::keep(sum);
+}
+
+// Keeps the ring half full so first_ constantly wraps around the end
+BENCH(Queue, wraparound)
+{
+  Queue<String> queue(64);
+  for (int i = 0; i < 40; i++)
+    queue.enqueue("queued");
+  String item("queued");
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    queue.enqueue(item);
+    String out = queue.dequeue();
+    Bench::keep(out);
+  }
+}
+
+// One op enqueues a single item; growth is included by restarting every 64K
+BENCH(Queue, enqueue_grow)
+{
+  Queue<int> queue;
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 65535) == 0)
+      queue = Queue<int>();
+    queue.enqueue((int)i);
+  }
+  Bench::keep(queue);
+}
+
+// One op moves one item through a 256 item batch
+BENCH(Queue, batch)
+{
+  Queue<int> queue;
+  List<int> in;
+  for (int i = 0; i < 256; i++)
+    in.add(i);
+  List<int> out(256);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i += 256) {
+    queue.enqueue(in);
+    out = List<int>(256);
+    queue.dequeue(out, 256);
+  }
+  Bench::keep(out);
+}
+
+// Producer/consumer throughput: one op is one item handed from a producer
+// thread to the consumer (the benchmark thread) through a ring of
+// HandoffSize. Every LatencySample-th item carries its enqueue time, so
+// the latency columns are enqueue-to-dequeue times of those items.
+static const size_t HandoffSize = 1024;
+static const size_t LatencySample = 64;
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The mutex-wrapped Queue a SpscQueue replaces, bounded the same way
+class LockedQueue {
+  public:
+    LockedQueue(size_t size) :
+      queue_(size),
+      size_(size)
+    {}
+
+    bool tryEnqueue(uint64_t item)
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (queue_.count() == size_)
+        return false;
+      queue_.enqueue(item);
+      return true;
+    }
+
+    bool tryDequeue(uint64_t& item)
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (queue_.count() == 0)
+        return false;
+      item = queue_.dequeue();
+      return true;
+    }
+
+    void enqueue(uint64_t item)
+    {
+      while (!tryEnqueue(item))
+        std::this_thread::yield();
+    }
+
+    void dequeue(uint64_t& item)
+    {
+      while (!tryDequeue(item))
+        std::this_thread::yield();
+    }
+
+  private:
+    std::mutex mutex_;
+    Queue<uint64_t> queue_;
+    size_t size_;
+};
+
+// SpscQueue's calls are the try calls, under the names the others use for
+// blocking ones
+static bool tryEnqueue(SpscQueue<uint64_t>& queue, uint64_t item) { return queue.enqueue(item); }
+static bool tryDequeue(SpscQueue<uint64_t>& queue, uint64_t& item) { return queue.dequeue(item); }
+static bool tryEnqueue(LockedQueue& queue, uint64_t item) { return queue.tryEnqueue(item); }
+static bool tryDequeue(LockedQueue& queue, uint64_t& item) { return queue.tryDequeue(item); }
+
+template <typename Q>
+static void handoff(Bench::State& state)
+{
+  Q queue(HandoffSize);
+  size_t count = state.count();
+  state.resetTimer();
+  std::thread producer([&queue, count]() {
+    for (size_t i = 0; i < count; i++) {
+      uint64_t item = i % LatencySample == 0 ? nowNs() : 0;
+      while (!tryEnqueue(queue, item))
+        std::this_thread::yield();
+    }
+  });
+  for (size_t i = 0; i < count; i++) {
+    uint64_t item;
+    while (!tryDequeue(queue, item))
+      std::this_thread::yield();
+    if (item != 0)
+      state.recordLatency((nowNs() - item) * 1e-9);
+  }
+  producer.join();
+}
+
+BENCH(Queue, handoff_spsc) { handoff<SpscQueue<uint64_t>>(state); }
+BENCH(Queue, handoff_locked) { handoff<LockedQueue>(state); }
+
+// Contention: each thread repeatedly enqueues an item and then dequeues
+// one, so every thread is both producer and consumer and a dequeue never
+// finds the queue empty. One op is one enqueue and dequeue; state.count()
+// ops are split across the threads, so ns/op is wall time per op.
+template <typename Q>
+static void contend(Bench::State& state, unsigned threads)
+{
+  Q queue(HandoffSize);
+  size_t perThread = state.count() / threads + 1;
+  List<std::thread> workers;
+  state.resetTimer();
+  for (unsigned t = 0; t < threads; t++) {
+    workers.add(std::thread([&queue, perThread]() {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < perThread; i++) {
+        uint64_t item;
+        queue.enqueue(i);
+        queue.dequeue(item);
+        sum += item;
+      }
+      Bench::keep(sum);
+    }));
+  }
+  for (size_t t = 0; t < workers.count(); t++)
+    workers[t].join();
+}
+
+#define CONTENTION_BENCHES(threads)                                             \
+  BENCH(Queue, contend_mpmc_##threads)                                          \
+  { contend<MpmcQueue<uint64_t>>(state, threads); }                             \
+  BENCH(Queue, contend_locked_##threads)                                        \
+  { contend<LockedQueue>(state, threads); }
+
+CONTENTION_BENCHES(1)
+CONTENTION_BENCHES(2)
+CONTENTION_BENCHES(4)
+CONTENTION_BENCHES(8)
+CONTENTION_BENCHES(16)
+CONTENTION_BENCHES(32)
+CONTENTION_BENCHES(64)
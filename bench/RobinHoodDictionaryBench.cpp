@@ -0,0 +1,158 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Dictionary.h"
+#include "Base/FlatDictionary.h"
+#include "Base/RobinHoodDictionary.h"
+
+using namespace Base;
+
+// uint32_t keyed tables from 1M to 100M entries, where lookups miss the
+// cache: Dictionary, FlatDictionary and RobinHoodDictionary one lookup at a
+// time, and RobinHoodDictionary::lookupBatch in batches of 1024. One op is
+// one lookup (or insert). Probes are a fixed pseudo-random sequence over
+// the keys, half of them misses.
+
+static const size_t Probes = 1 << 20;
+static const size_t Batch = 1024;
+
+// Distinct keys, since multiplying by an odd constant is a bijection
+static uint32_t key(size_t i)
+{
+  return (uint32_t)(i * 2654435761u);
+}
+
+static List<uint32_t> const& probes(size_t count)
+{
+  static List<uint32_t> list;
+  static size_t listCount = 0;
+  if (listCount != count) {
+    list = List<uint32_t>(Probes);
+    uint64_t seed = 88172645463325252ull;
+    for (size_t i = 0; i < Probes; i++) {
+      seed ^= seed << 13;
+      seed ^= seed >> 7;
+      seed ^= seed << 17;
+      // indexes past count are keys that were never added
+      list.add(key(seed % (count * 2)));
+    }
+    listCount = count;
+  }
+  return list;
+}
+
+// Only one table is kept alive at a time, since two 100M entry tables do
+// not fit alongside each other on smaller machines
+template <typename D>
+static D& table(size_t count)
+{
+  static void* current = nullptr;
+  static void (*destroyCurrent)(void*) = nullptr;
+  static size_t currentCount = 0;
+  static void* currentType = nullptr;
+  // The address of this function's static identifies D
+  static char type;
+  if (current == nullptr || currentType != &type || currentCount != count) {
+    if (current != nullptr)
+      destroyCurrent(current);
+    current = nullptr;
+    D* dict = new D(count);
+    for (size_t i = 0; i < count; i++)
+      dict->add(key(i), (int)i);
+    current = dict;
+    destroyCurrent = [](void* p) { delete (D*)p; };
+    currentCount = count;
+    currentType = &type;
+  }
+  return *(D*)current;
+}
+
+template <typename D>
+static void lookup(Bench::State& state, size_t count)
+{
+  D& dict = table<D>(count);
+  List<uint32_t> const& keys = probes(count);
+  state.resetTimer();
+  size_t found = 0;
+  for (size_t i = 0; i < state.count(); i++)
+    found += dict.containsKey(keys[i & (Probes - 1)]);
+  Bench::keep(found);
+}
+
+static void lookupBatch(Bench::State& state, size_t count)
+{
+  RobinHoodDictionary<uint32_t, int>& dict = table<RobinHoodDictionary<uint32_t, int>>(count);
+  List<uint32_t> const& keys = probes(count);
+  int* out[Batch];
+  state.resetTimer();
+  size_t found = 0;
+  for (size_t done = 0; done < state.count(); done += Batch) {
+    size_t start = done & (Probes - 1);
+    dict.lookupBatch(&keys[start], Batch, out);
+    for (size_t i = 0; i < Batch; i++)
+      found += out[i] != nullptr;
+  }
+  Bench::keep(found);
+}
+
+// Builds tables of count entries from the default size
+template <typename D>
+static void insert(Bench::State& state, size_t count)
+{
+  state.resetTimer();
+  size_t done = 0;
+  while (done < state.count()) {
+    D dict;
+    size_t n = std::min(count, state.count() - done);
+    for (size_t i = 0; i < n; i++)
+      dict.add(key(i), (int)i);
+    done += n;
+    state.stopTimer();
+    { D drop(std::move(dict)); }
+    state.startTimer();
+  }
+}
+
+template <typename K, typename V>
+using Chained = Dictionary<K, V>;
+template <typename K, typename V>
+using Flat = FlatDictionary<K, V>;
+template <typename K, typename V>
+using RobinHood = RobinHoodDictionary<K, V>;
+
+// Chained tables go last: freed nodes stay in the C allocator's free lists
+// rather than going back to the system, so a 100M entry chained table
+// would leave too little memory for the tables after it
+#define ROBIN_HOOD_BENCHES(size, count)                                         \
+  BENCH(RobinHood, lookup_##size##_robin_hood_batch)                            \
+  { lookupBatch(state, count); }                                                \
+  BENCH(RobinHood, lookup_##size##_robin_hood)                                  \
+  { lookup<RobinHood<uint32_t, int>>(state, count); }                           \
+  BENCH(RobinHood, lookup_##size##_flat)                                        \
+  { lookup<Flat<uint32_t, int>>(state, count); }                                \
+  BENCH(RobinHood, lookup_##size##_chained)                                     \
+  { lookup<Chained<uint32_t, int>>(state, count); }                             \
+  BENCH(RobinHood, insert_##size##_robin_hood)                                  \
+  { insert<RobinHood<uint32_t, int>>(state, count); }                           \
+  BENCH(RobinHood, insert_##size##_flat)                                        \
+  { insert<Flat<uint32_t, int>>(state, count); }                                \
+  BENCH(RobinHood, insert_##size##_chained)                                     \
+  { insert<Chained<uint32_t, int>>(state, count); }
+
+ROBIN_HOOD_BENCHES(1M, 1000000)
+ROBIN_HOOD_BENCHES(10M, 10000000)
+ROBIN_HOOD_BENCHES(100M, 100000000)
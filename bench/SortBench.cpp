@@ -0,0 +1,115 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Parallel.h"
+#include "Base/String.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+using namespace Base;
+
+// One op sorts a whole list of random items; refilling it from the
+// unsorted copy is not timed. std_vector is the old workaround of copying
+// into a std::vector for std::sort and back, copies included.
+
+static uint64_t nextRandom(uint64_t& state)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static void randomItems(List<int>& list, size_t count)
+{
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < count; i++)
+    list.add((int)nextRandom(state));
+}
+
+static void randomItems(List<double>& list, size_t count)
+{
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < count; i++)
+    list.add((double)(int64_t)nextRandom(state) / 1e6);
+}
+
+// Short enough to stay inline, with a common prefix like real keys
+static void randomItems(List<String>& list, size_t count)
+{
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  char buffer[32];
+  for (size_t i = 0; i < count; i++) {
+    snprintf(buffer, sizeof(buffer), "key:%llu", (unsigned long long)(nextRandom(state) % 1000000000000ull));
+    list.add(String(buffer));
+  }
+}
+
+enum class Mode { Sort, Stable, Parallel, StdVector };
+
+template <typename T>
+static void sortBench(Bench::State& state, size_t count, Mode mode)
+{
+  List<T> unsorted(count);
+  randomItems(unsorted, count);
+  List<T> list;
+  state.resetTimer();
+  for (size_t n = 0; n < state.count(); n++) {
+    state.stopTimer();
+    list = unsorted;
+    state.startTimer();
+    switch (mode) {
+      case Mode::Sort:
+        list.sort();
+        break;
+      case Mode::Stable:
+        list.stableSort();
+        break;
+      case Mode::Parallel:
+        parallelSort(list);
+        break;
+      case Mode::StdVector: {
+        std::vector<T> items;
+        items.reserve(list.count());
+        for (auto it = list.iter(); it.valid(); it.next())
+          items.push_back(it.value());
+        std::sort(items.begin(), items.end());
+        list = List<T>(items.data(), items.size());
+        break;
+      }
+    }
+    Bench::keep(list);
+  }
+}
+
+#define SORT_BENCHES(type, T, size, count)                                      \
+  BENCH(Sort, type##_##size##_sort) { sortBench<T>(state, count, Mode::Sort); } \
+  BENCH(Sort, type##_##size##_stable) { sortBench<T>(state, count, Mode::Stable); } \
+  BENCH(Sort, type##_##size##_parallel) { sortBench<T>(state, count, Mode::Parallel); } \
+  BENCH(Sort, type##_##size##_std_vector) { sortBench<T>(state, count, Mode::StdVector); }
+
+SORT_BENCHES(int, int, 1K, 1000)
+SORT_BENCHES(int, int, 1M, 1000000)
+SORT_BENCHES(int, int, 100M, 100000000)
+SORT_BENCHES(double, double, 1K, 1000)
+SORT_BENCHES(double, double, 1M, 1000000)
+SORT_BENCHES(double, double, 100M, 100000000)
+SORT_BENCHES(string, String, 1K, 1000)
+SORT_BENCHES(string, String, 1M, 1000000)
+SORT_BENCHES(string, String, 10M, 10000000)
@@ -0,0 +1,57 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/Stack.h"
+#include "Base/String.h"
+
+using namespace Base;
+
+// One op is a push and a pop on a stack that stays near empty
+BENCH(Stack, push_pop)
+{
+  Stack<int> stack;
+  int64_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++) {
+    stack.push((int)i);
+    sum += stack.pop();
+  }
+  Bench::keep(sum);
+}
+
+BENCH(Stack, push_pop_string)
+{
+  Stack<String> stack;
+  String item("stacked");
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    stack.push(item);
+    String out = stack.pop();
+    Bench::keep(out);
+  }
+}
+
+// One op pushes a single item; growth is included by restarting every 64K
+BENCH(Stack, push_grow)
+{
+  Stack<int> stack;
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 65535) == 0)
+      stack = Stack<int>();
+    stack.push((int)i);
+  }
+  Bench::keep(stack);
+}
@@ -0,0 +1,272 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/bench/Bench.h"
+#include "Base/String.h"
+#include "Base/StringBuilder.h"
+#include "Base/StringSearch.h"
+
+#include <string.h>
+
+using namespace Base;
+
+static char const* const shortText = "short key";
+static char const* const longText =
+  "a string long enough that it never fits in the inline buffer";
+
+static String sentence(size_t words)
+{
+  String ret;
+  for (size_t i = 0; i < words; i++) {
+    ret += (i % 3 == 0) ? "alpha" : (i % 3 == 1) ? "beta" : "gamma";
+    ret += ' ';
+  }
+  return ret;
+}
+
+BENCH(String, construct_short)
+{
+  for (size_t i = 0; i < state.count(); i++) {
+    String s(shortText);
+    Bench::keep(s);
+  }
+}
+
+BENCH(String, construct_long)
+{
+  for (size_t i = 0; i < state.count(); i++) {
+    String s(longText);
+    Bench::keep(s);
+  }
+}
+
+BENCH(String, copy_long)
+{
+  String src(longText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    String s(src);
+    Bench::keep(s);
+  }
+}
+
+BENCH(String, concat)
+{
+  String a(shortText);
+  String b(longText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    String s = a + b;
+    Bench::keep(s);
+  }
+}
+
+BENCH(String, concat4)
+{
+  String a(shortText);
+  String b(longText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    String s = a + " / " + b + '!';
+    Bench::keep(s);
+  }
+}
+
+BENCH(String, concat4_single)
+{
+  String a(shortText);
+  String b(longText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    String s = String::concat(a, " / ", b, '!');
+    Bench::keep(s);
+  }
+}
+
+BENCH(String, builder_format)
+{
+  for (size_t i = 0; i < state.count(); i++) {
+    StringBuilder sb;
+    sb << "item " << (int)i << " of " << state.count() << " at " << 0.25 * i;
+    String s = sb.toString();
+    Bench::keep(s);
+  }
+}
+
+// One op appends a single char; the string is restarted every 4K chars
+BENCH(String, append_char)
+{
+  String s;
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 4095) == 0)
+      s = "";
+    s += 'x';
+  }
+  Bench::keep(s);
+}
+
+BENCH(String, append_word)
+{
+  String s;
+  for (size_t i = 0; i < state.count(); i++) {
+    if ((i & 1023) == 0)
+      s = "";
+    s += "word ";
+  }
+  Bench::keep(s);
+}
+
+// One op splits a 64 word sentence
+BENCH(String, split)
+{
+  String s = sentence(64);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    List<String> parts = s.split(" ");
+    Bench::keep(parts);
+  }
+}
+
+// One op replaces every "beta" in a 64 word sentence
+BENCH(String, replace)
+{
+  String s = sentence(64);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    String r = s.replace("beta", "BETA!");
+    Bench::keep(r);
+  }
+}
+
+BENCH(String, contains_hit)
+{
+  String s = sentence(256) + "needle";
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    bool found = s.contains("needle");
+    Bench::keep(found);
+  }
+}
+
+BENCH(String, contains_miss)
+{
+  String s = sentence(256);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    bool found = s.contains("needle");
+    Bench::keep(found);
+  }
+}
+
+BENCH(String, hash_short)
+{
+  String s(shortText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    uint64_t h = s.hash();
+    Bench::keep(h);
+  }
+}
+
+BENCH(String, hash_long)
+{
+  String s(longText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    uint64_t h = s.hash();
+    Bench::keep(h);
+  }
+}
+
+BENCH(String, equals_long)
+{
+  String a(longText);
+  String b(longText);
+  state.resetTimer();
+  for (size_t i = 0; i < state.count(); i++) {
+    bool eq = a == b;
+    Bench::keep(eq);
+  }
+}
+
+// Substring search for an absent 12 byte needle in pseudo-random lowercase
+// text: StringSearch::find, its scalar filter, the byte-by-byte loop that
+// contains() used before it, and glibc memmem. One op searches the whole
+// haystack, so bytes/s is its length times ops_per_sec.
+static char const searchNeedle[] = "qzqzjxkvbwyq";
+
+static char const* searchText()
+{
+  static List<char> text;
+  if (text.count() == 0) {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < ((size_t)64 << 20); i++) {
+      seed = seed * 1664525 + 1013904223;
+      text.add((char)('a' + (seed >> 24) % 26));
+    }
+  }
+  return &text[0];
+}
+
+// Out of line, as it was as a String member
+__attribute__((noinline))
+static off_t findLoop(char const* haystack, size_t length, char const* needle, size_t needleLength)
+{
+  for (off_t i = 0; i <= (ssize_t)length - (ssize_t)needleLength; ++i) {
+    size_t j = 0;
+    while (j < needleLength && haystack[i + j] == needle[j])
+      j++;
+    if (j == needleLength)
+      return i;
+  }
+  return -1;
+}
+
+static off_t findMemmem(char const* haystack, size_t length, char const* needle, size_t needleLength)
+{
+  void const* found = memmem(haystack, length, needle, needleLength);
+  return found == nullptr ? -1 : (char const*)found - haystack;
+}
+
+template <off_t (*Find)(char const*, size_t, char const*, size_t)>
+static void search(Bench::State& state, size_t length)
+{
+  char const* text = searchText();
+  size_t needleLength = sizeof(searchNeedle) - 1;
+  state.resetTimer();
+  off_t sum = 0;
+  for (size_t i = 0; i < state.count(); i++) {
+    // Shift the start so short searches don't always see the same bytes
+    sum += Find(text + (i & 63), length, searchNeedle, needleLength);
+  }
+  Bench::keep(sum);
+}
+
+#define SEARCH_BENCHES(size, length)                                            \
+  BENCH(StringSearch, find_##size)                                              \
+  { search<StringSearch::find>(state, length); }                                \
+  BENCH(StringSearch, scalar_##size)                                            \
+  { search<StringSearch::findScalar>(state, length); }                          \
+  BENCH(StringSearch, loop_##size)                                              \
+  { search<findLoop>(state, length); }                                          \
+  BENCH(StringSearch, memmem_##size)                                            \
+  { search<findMemmem>(state, length); }
+
+SEARCH_BENCHES(16, 16)
+SEARCH_BENCHES(64, 64)
+SEARCH_BENCHES(4K, 4 << 10)
+SEARCH_BENCHES(1M, 1 << 20)
+SEARCH_BENCHES(64M, (64 << 20) - 64)
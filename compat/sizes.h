@@ -53,4 +53,6 @@
 #define SZ_1G		0x40000000
 #define SZ_2G		0x80000000
 
+#define SZ_CACHE_LINE	SZ_64
+
 #endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/test/Test.h"
+#include "Base/ConcurrentDictionary.h"
+
+using namespace Base;
+
+TEST(ConcurrentDictionary, tryGet_getOrAdd)
+{
+  ConcurrentDictionary<uint64_t, int> dict;
+  int value = 0;
+  CHECK(!dict.tryGet(1, value));
+  CHECK(dict.getOrAdd(1, 10) == 10);
+  CHECK(dict.getOrAdd(1, 20) == 10);
+  CHECK(dict.tryGet(1, value) && value == 10);
+  for (uint64_t i = 0; i < 1000; i++)
+    CHECK(dict.getOrAdd(i + 2, (int)i) == (int)i);
+  CHECK(dict.count() == 1001);
+}
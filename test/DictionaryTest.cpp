@@ -0,0 +1,78 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/test/Test.h"
+#include "Base/Dictionary.h"
+#include "Base/String.h"
+
+using namespace Base;
+
+TEST(Dictionary, remove_absent)
+{
+  Dictionary<String, int> dict;
+  dict.add("a", 1);
+  CHECK(!dict.remove("b"));
+  CHECK(dict.count() == 1);
+  CHECK(dict.remove("a"));
+  CHECK(!dict.remove("a"));
+  CHECK(dict.count() == 0);
+}
+
+TEST(Dictionary, remove_absent_moved_from)
+{
+  Dictionary<uint64_t, int> dict;
+  dict.add(1, 1);
+  Dictionary<uint64_t, int> other(std::move(dict));
+  CHECK(!dict.remove(1));
+  CHECK(other.remove(1));
+}
+
+TEST(Dictionary, remove_absent_while_rehashing)
+{
+  Dictionary<uint64_t, int> dict;
+  dict.setIncrementalRehash(true);
+  for (uint64_t i = 0; i < 1000; i++) {
+    dict.add(i, (int)i);
+    CHECK(!dict.remove(i + 1000));
+  }
+  CHECK(dict.count() == 1000);
+  for (uint64_t i = 0; i < 1000; i++)
+    CHECK(dict.containsKey(i) && dict[i] == (int)i);
+}
+
+// Lookups alone never finish a rehash; reserve and shrinkToFit do
+TEST(Dictionary, reserve_finishes_rehash)
+{
+  for (int shrink = 0; shrink < 2; shrink++) {
+    Dictionary<uint64_t, int> dict;
+    dict.setIncrementalRehash(true);
+    uint64_t i = 0;
+    for (; !dict.rehashing(); i++)
+      dict.add(i, (int)i);
+    for (uint64_t j = 0; j < i; j++)
+      CHECK(dict[j] == (int)j);
+    CHECK(dict.rehashing());
+    if (shrink)
+      dict.shrinkToFit();
+    else
+      dict.reserve(dict.count());
+    CHECK(!dict.rehashing());
+    CHECK(dict.count() == i);
+    for (uint64_t j = 0; j < i; j++)
+      CHECK(dict.containsKey(j) && dict[j] == (int)j);
+  }
+}
@@ -0,0 +1,142 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/test/Test.h"
+#include "Base/FlatDictionary.h"
+#include "Base/String.h"
+
+using namespace Base;
+
+TEST(FlatDictionary, remove_absent)
+{
+  FlatDictionary<String, int> dict;
+  CHECK(!dict.remove("a"));
+  dict.add("a", 1);
+  CHECK(!dict.remove("b"));
+  CHECK(dict.remove("a"));
+  CHECK(!dict.remove("a"));
+  CHECK(dict.count() == 0);
+
+  FlatDictionary<String, int> moved(std::move(dict));
+  CHECK(!dict.remove("a"));
+}
+
+// Counts the T_Key objects built from some other type
+struct Converted {
+  static int made;
+  uint64_t value;
+
+  Converted(uint64_t value) :
+    value(value)
+  {
+    made++;
+  }
+
+  uint64_t hash() const
+  {
+    return Base::hash<uint64_t>(value);
+  }
+
+  bool operator== (Converted const& other) const
+  {
+    return value == other.value;
+  }
+};
+
+int Converted::made = 0;
+
+TEST(FlatDictionary, emplace_converts_once)
+{
+  FlatDictionary<Converted, int> dict;
+  Converted::made = 0;
+  for (uint64_t i = 0; i < 100; i++)
+    dict.emplace(i, (int)i);
+  CHECK(Converted::made == 100);
+  for (uint64_t i = 0; i < 100; i++)
+    CHECK(dict[Converted(i)] == (int)i);
+}
+
+// Tracks live values and throws from the copy that makes copiesLeft zero
+struct Fragile {
+  static int live;
+  static int copiesLeft;
+  int value;
+
+  Fragile(int value) :
+    value(value)
+  {
+    live++;
+  }
+
+  Fragile(Fragile const& other) :
+    value(other.value)
+  {
+    if (--copiesLeft == 0)
+      throw 1;
+    live++;
+  }
+
+  ~Fragile()
+  {
+    live--;
+  }
+};
+
+int Fragile::live = 0;
+int Fragile::copiesLeft = 0;
+
+TEST(FlatDictionary, copy_throws)
+{
+  {
+    FlatDictionary<uint64_t, Fragile> dict;
+    for (uint64_t i = 0; i < 100; i++)
+      dict.emplace(i, (int)i);
+    Fragile::copiesLeft = 50;
+    bool threw = false;
+    try {
+      FlatDictionary<uint64_t, Fragile> copy(dict);
+    } catch (int) {
+      threw = true;
+    }
+    CHECK(threw);
+    CHECK(Fragile::live == 100);
+
+    // A failed emplace leaves the table as it was
+    Fragile::copiesLeft = 1;
+    Fragile extra(1000);
+    threw = false;
+    try {
+      dict.emplace(1000, extra);
+    } catch (int) {
+      threw = true;
+    }
+    CHECK(threw);
+    CHECK(dict.count() == 100 && !dict.containsKey(1000));
+    CHECK(Fragile::live == 101);
+  }
+  CHECK(Fragile::live == 0);
+}
+
+TEST(FlatDictionary, tryGet_getOrAdd)
+{
+  FlatDictionary<uint64_t, int> dict;
+  CHECK(dict.tryGet(1) == nullptr);
+  for (uint64_t i = 0; i < 1000; i++)
+    dict.getOrAdd(i % 100, [] { return 0; }) += 1;
+  CHECK(dict.count() == 100);
+  for (uint64_t i = 0; i < 100; i++)
+    CHECK(dict.tryGet(i) != nullptr && *dict.tryGet(i) == 10);
+}
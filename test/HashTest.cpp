@@ -0,0 +1,108 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/test/Test.h"
+#include "Base/Hash.h"
+#include "Base/List.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Base;
+
+// Chi-squared of Keys hashes over Buckets buckets, taking the bucket from
+// the low bits (as Dictionary's modulo does) or the high bits (as the
+// open-addressing tables do). With df = Buckets - 1 the statistic has mean
+// df and standard deviation sqrt(2 df) (362 here); a sound hash stays
+// within a few of those.
+static const size_t Buckets = 1 << 16;
+static const size_t Keys = 1 << 22;
+static const double Limit = (Buckets - 1) + 6 * 362.0;
+
+template <typename F>
+static void chiSquared(F hashOf, double& low, double& high)
+{
+  List<uint32_t> lowCounts;
+  List<uint32_t> highCounts;
+  for (size_t i = 0; i < Buckets; i++) {
+    lowCounts.add(0u);
+    highCounts.add(0u);
+  }
+  for (uint64_t i = 0; i < Keys; i++) {
+    uint64_t h = hashOf(i);
+    lowCounts[h & (Buckets - 1)]++;
+    highCounts[h >> 48]++;
+  }
+  double expected = (double)Keys / Buckets;
+  low = high = 0;
+  for (size_t i = 0; i < Buckets; i++) {
+    low += (lowCounts[i] - expected) * (lowCounts[i] - expected) / expected;
+    high += (highCounts[i] - expected) * (highCounts[i] - expected) / expected;
+  }
+}
+
+template <typename F>
+static void checkDistribution(char const* name, F hashOf)
+{
+  double low;
+  double high;
+  chiSquared(hashOf, low, high);
+  if (low >= Limit || high >= Limit)
+    printf("  %s: chi-squared %.0f (low bits), %.0f (high bits), limit %.0f\n",
+           name, low, high, Limit);
+  CHECK(low < Limit);
+  CHECK(high < Limit);
+}
+
+TEST(Hash, integer_distribution)
+{
+  checkDistribution("sequential", [](uint64_t i) { return hash<uint64_t>(i); });
+  checkDistribution("shifted", [](uint64_t i) { return hash<uint64_t>(i << 16); });
+  checkDistribution("high bits", [](uint64_t i) { return hash<uint64_t>(i << 42); });
+}
+
+TEST(Hash, bytes_distribution)
+{
+  checkDistribution("user:N", [](uint64_t i) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "user:%llu", (unsigned long long)i);
+    return Hash::bytes(buf, n);
+  });
+  // Keys that differ in a few bytes in the middle of a 100 byte block, so
+  // the bulk loop has to spread them
+  checkDistribution("counter in block", [](uint64_t i) {
+    uint8_t buf[100] = {};
+    memcpy(buf + 40, &i, sizeof(i));
+    return Hash::bytes(buf, sizeof(buf));
+  });
+}
+
+TEST(Hash, seed)
+{
+  char const text[] = "a key long enough to reach the 48 byte bulk loop of bytes()";
+  uint64_t before = Hash::bytes(text, sizeof(text));
+  uint64_t integer = hash<uint64_t>(42);
+  Hash::setSeed(7);
+  CHECK(Hash::bytes(text, sizeof(text)) != before);
+  CHECK(hash<uint64_t>(42) != integer);
+  // The default key is a precomputed constant; setting the default seed
+  // again must reproduce it
+  Hash::setSeed(0);
+  CHECK(Hash::bytes(text, sizeof(text)) == before);
+  CHECK(Hash::bytes("", 0) == Hash::bytes(text, 0));
+  CHECK(hash<uint64_t>(42) == integer);
+}
@@ -0,0 +1,45 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/test/Test.h"
+#include "Base/MappedFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Base;
+
+// /proc files report a size of 0 but have content
+TEST(MappedFile, proc_file)
+{
+  MappedFile file("/proc/self/status");
+  CHECK(!file.isMapped());
+  CHECK(file.length() > 0);
+  CHECK(file.view().startsWith("Name:"));
+}
+
+TEST(MappedFile, empty_file)
+{
+  char path[] = "/tmp/base_test_empty_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  MappedFile file(fd);
+  CHECK(file.length() == 0);
+  CHECK(!file.lines().valid());
+  close(fd);
+  unlink(path);
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/test/Test.h"
+#include "Base/RcuDictionary.h"
+
+using namespace Base;
+
+TEST(RcuDictionary, add_set_remove)
+{
+  RcuDictionary<uint64_t, int> dict;
+  CHECK(dict.add(1, 1));
+  CHECK(!dict.add(1, 2));
+  CHECK(dict[1] == 1);
+  CHECK(!dict.set(1, 3));
+  CHECK(dict[1] == 3);
+  CHECK(dict.set(2, 2));
+  CHECK(dict.count() == 2);
+  CHECK(dict.remove(1));
+  CHECK(!dict.remove(1));
+  CHECK(dict.count() == 1);
+  int value = 0;
+  CHECK(!dict.tryGet(1, value));
+  CHECK(dict.tryGet(2, value) && value == 2);
+}
+
+// Removing from the front, middle or end of a chain leaves the rest
+// reachable, and every unlinked node is freed
+TEST(RcuDictionary, remove_from_chains)
+{
+  RcuDictionary<uint64_t, int> dict(256);
+  for (uint64_t i = 0; i < 256; i++)
+    dict.add(i, (int)i);
+  for (uint64_t i = 0; i < 256; i += 2)
+    CHECK(dict.remove(i));
+  for (uint64_t i = 0; i < 256; i++) {
+    int value = 0;
+    CHECK(dict.tryGet(i, value) == (i % 2 == 1));
+    CHECK(i % 2 == 0 || value == (int)i);
+  }
+  Epoch::collect();
+  CHECK(Epoch::pending() == 0);
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base/test/Test.h"
+#include "Base/RobinHoodDictionary.h"
+
+using namespace Base;
+
+TEST(RobinHoodDictionary, remove_absent)
+{
+  RobinHoodDictionary<uint64_t, int> dict;
+  CHECK(!dict.remove(1));
+  dict.add(1, 1);
+  CHECK(!dict.remove(2));
+  CHECK(dict.remove(1));
+  CHECK(!dict.remove(1));
+  CHECK(dict.count() == 0);
+
+  RobinHoodDictionary<uint64_t, int> moved(std::move(dict));
+  CHECK(!dict.remove(1));
+}
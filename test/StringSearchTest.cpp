@@ -0,0 +1,75 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/test/Test.h"
+#include "Base/StringSearch.h"
+
+#include <string>
+
+using namespace Base;
+
+// Random haystacks and needles over small alphabets, so that matches and
+// near misses are common, checked against std::string. Lengths cover the
+// short path and the vector blocks with every tail length.
+TEST(StringSearch, find_matches_std)
+{
+  uint32_t seed = 1;
+  auto next = [&seed]() {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+  };
+  for (int round = 0; round < 20000; round++) {
+    size_t alphabet = 2 + next() % 3;
+    std::string haystack(next() % 160, 'a');
+    for (size_t i = 0; i < haystack.length(); i++)
+      haystack[i] = (char)('a' + next() % alphabet);
+    std::string needle(1 + next() % 40, 'a');
+    for (size_t i = 0; i < needle.length(); i++)
+      needle[i] = (char)('a' + next() % alphabet);
+    // Plant the needle half the time
+    if (next() % 2 == 0 && needle.length() <= haystack.length()) {
+      size_t at = next() % (haystack.length() - needle.length() + 1);
+      haystack.replace(at, needle.length(), needle);
+    }
+
+    size_t expected = haystack.find(needle);
+    off_t want = expected == std::string::npos ? -1 : (off_t)expected;
+    CHECK(StringSearch::find(haystack.data(), haystack.length(),
+                             needle.data(), needle.length()) == want);
+    CHECK(StringSearch::findScalar(haystack.data(), haystack.length(),
+                                   needle.data(), needle.length()) == want);
+    CHECK(StringSearch::findTwoWay(haystack.data(), haystack.length(),
+                                   needle.data(), needle.length()) == want);
+
+    size_t expectedR = haystack.rfind(needle);
+    off_t wantR = expectedR == std::string::npos ? -1 : (off_t)expectedR;
+    CHECK(StringSearch::findR(haystack.data(), haystack.length(),
+                              needle.data(), needle.length()) == wantR);
+  }
+}
+
+TEST(StringSearch, find_at_end)
+{
+  // A match in the last position of every length, which only the final,
+  // overlapping block of the vector paths sees
+  for (size_t length = 2; length < 200; length++) {
+    std::string haystack(length - 2, 'x');
+    haystack += "ab";
+    CHECK(StringSearch::find(haystack.data(), length, "ab", 2) == (off_t)length - 2);
+    CHECK(StringSearch::find(haystack.data(), length, "ba", 2) == -1);
+  }
+}
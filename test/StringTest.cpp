@@ -0,0 +1,98 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/test/Test.h"
+#include "Base/String.h"
+
+#include <string.h>
+
+using namespace Base;
+
+template <typename T>
+static size_t lengthOf(T const& value)
+{
+  return value.length();
+}
+
+static void append(String& target, String const& value)
+{
+  target += value;
+}
+
+TEST(String, plus_returns_string)
+{
+  String a("left");
+  String b("right");
+  CHECK(strcmp((a + b).c_str(), "leftright") == 0);
+  CHECK((a + " " + b).length() == 10);
+  CHECK(lengthOf(a + b + '!') == 10);
+  auto s = a + ", " + b;
+  CHECK(s == "left, right");
+  String t;
+  append(t, a + b);
+  CHECK(t == "leftright");
+}
+
+TEST(String, plus_temporaries)
+{
+  String a("a string long enough that it never fits in the inline buffer");
+  String s = String("x") + a + String("y") + 'z';
+  CHECK(s.length() == a.length() + 3);
+  CHECK(s.view().startsWith("xa string") && s.view().endsWith("bufferyz"));
+  CHECK("<" + a.substring(0, 1) + ">" == "<a>");
+  CHECK(a.view().substring(0, 8) + a == "a string" + a);
+}
+
+TEST(String, concat)
+{
+  String a("alpha");
+  CHECK(String::concat() == "");
+  CHECK(String::concat(a) == "alpha");
+  CHECK(String::concat(a, ' ', "beta", '/', a.view().substring(1)) == "alpha beta/lpha");
+}
+
+// Appending a view of the string itself, from inline and heap strings,
+// with and without the append having to grow the buffer
+TEST(String, append_own_view)
+{
+  String s("abcdef");
+  s += s.view();
+  CHECK(s == "abcdefabcdef");
+  s += s.view(2);
+  CHECK(s == "abcdefabcdefcdefabcdef");
+  s += s.view(0, 4);
+  CHECK(s == "abcdefabcdefcdefabcdefabcd");
+
+  String heap("a string that already lives on the heap");
+  for (int i = 0; i < 4; i++)
+    heap += heap.view();
+  CHECK(heap.length() == 16 * 39);
+  for (int i = 0; i < 16; i++)
+    CHECK(heap.view().substring(i * 39, 39) == "a string that already lives on the heap");
+
+  String tail("0123456789");
+  tail += tail.c_str() + 5;
+  CHECK(tail == "012345678956789");
+}
+
+TEST(String, substring_full_length)
+{
+  String s("0123456789");
+  CHECK(s.substring(0, s.length()) == s);
+  CHECK(s.substring(5, 5) == "56789");
+  CHECK(s.substring(3, 0).length() == 0);
+}
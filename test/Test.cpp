@@ -0,0 +1,75 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/test/Test.h"
+#include "Base/List.h"
+#include "Base/StringView.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Test;
+
+namespace
+{
+  struct Entry {
+    char const* name;
+    Function function;
+  };
+
+  Base::List<Entry>& registry()
+  {
+    static Base::List<Entry> entries;
+    return entries;
+  }
+
+  size_t failures = 0;
+}
+
+Registration::Registration(char const* name, Function function)
+{
+  registry().add(Entry{name, function});
+}
+
+void Test::fail(char const* file, int line, char const* condition)
+{
+  printf("  %s:%d: CHECK(%s) failed\n", file, line, condition);
+  failures++;
+}
+
+// base_test [FILTER] runs the tests whose name contains FILTER
+int main(int argc, char** argv)
+{
+  char const* filter = argc > 1 ? argv[1] : "";
+  Base::List<Entry>& entries = registry();
+  size_t failed = 0;
+  size_t run = 0;
+  for (off_t i = 0; i < (ssize_t)entries.count(); i++) {
+    Entry const& entry = entries[i];
+    if (!Base::StringView(entry.name).contains(filter))
+      continue;
+    size_t before = failures;
+    entry.function();
+    run++;
+    if (failures != before) {
+      printf("FAIL %s\n", entry.name);
+      failed++;
+    }
+  }
+  printf("%zu of %zu tests passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __Base_test_Test_h
+#define __Base_test_Test_h
+
+// Minimal test harness for base_test. A test is a function that CHECKs
+// conditions; failures are printed and counted, and the run exits non-zero
+// when any test failed. Checks stay active in release builds.
+namespace Test
+{
+  typedef void (*Function)();
+
+  class Registration {
+    public:
+      Registration(char const* name, Function function);
+  };
+
+  void fail(char const* file, int line, char const* condition);
+}
+
+#define CHECK(condition)                                  \
+  do {                                                    \
+    if (!(condition))                                     \
+      Test::fail(__FILE__, __LINE__, #condition);         \
+  } while (0)
+
+#define TEST(group, name)                                             \
+  static void test_##group##_##name();                                \
+  static Test::Registration reg_##group##_##name(#group "/" #name,    \
+                                                 test_##group##_##name); \
+  static void test_##group##_##name()
+
+#endif
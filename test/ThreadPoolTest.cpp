@@ -0,0 +1,81 @@
+/* Copyright (C) 2020 David Sloan
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Base/test/Test.h"
+#include "Base/ThreadPool.h"
+
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace Base;
+
+static double threadCpuSeconds()
+{
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+TEST(ThreadPool, wait_runs_all)
+{
+  ThreadPool pool(4);
+  std::atomic<size_t> done(0);
+  for (int round = 0; round < 200; round++) {
+    // Destroyed straight after wait, while the last task may just have
+    // finished
+    ThreadPool::Group group(pool);
+    for (int i = 0; i < 50; i++) {
+      group.spawn([&done, &group]() {
+        group.spawn([&done]() { done++; });
+        done++;
+      });
+    }
+    group.wait();
+  }
+  CHECK(done.load() == 200 * 50 * 2);
+}
+
+TEST(ThreadPool, wait_rethrows)
+{
+  ThreadPool pool(2);
+  ThreadPool::Group group(pool);
+  group.spawn([]() { throw std::runtime_error("task"); });
+  bool thrown = false;
+  try {
+    group.wait();
+  } catch (std::runtime_error const&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+TEST(ThreadPool, outside_wait_sleeps)
+{
+  ThreadPool pool(2);
+  ThreadPool::Group group(pool);
+  group.spawn([]() { std::this_thread::sleep_for(std::chrono::milliseconds(300)); });
+  // Give a worker time to take the task, so the wait has nothing to run
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  double before = threadCpuSeconds();
+  group.wait();
+  // Spinning through the wait would cost most of the remaining 250ms
+  CHECK(threadCpuSeconds() - before < 0.05);
+}